@@ -50,6 +50,13 @@ SHELL_COMMAND(ps_command,
 	      "ps",
 	      "ps: list all running processes",
 	      &shell_ps_process);
+#if PROCESS_CONF_ACCOUNTING
+PROCESS(shell_pstat_process, "pstat");
+SHELL_COMMAND(pstat_command,
+	      "pstat",
+	      "pstat: show process run times and event delays",
+	      &shell_pstat_process);
+#endif /* PROCESS_CONF_ACCOUNTING */
 /*---------------------------------------------------------------------------*/
 PROCESS_THREAD(shell_ps_process, ev, data)
 {
@@ -64,9 +71,33 @@ PROCESS_THREAD(shell_ps_process, ev, data)
   PROCESS_END();
 }
 /*---------------------------------------------------------------------------*/
+#if PROCESS_CONF_ACCOUNTING
+PROCESS_THREAD(shell_pstat_process, ev, data)
+{
+  struct process *p;
+  char buf[80];
+  PROCESS_BEGIN();
+
+  snprintf(buf, sizeof(buf), "%lu ticks/s: calls time max events delay max",
+	   (unsigned long)RTIMER_SECOND);
+  shell_output_str(&pstat_command, buf, "");
+  for(p = PROCESS_LIST(); p != NULL; p = p->next) {
+    snprintf(buf, sizeof(buf), " %lu %lu %lu %lu %lu %lu",
+	     p->acct.calls, p->acct.time, (unsigned long)p->acct.maxtime,
+	     p->acct.events, p->acct.delay, (unsigned long)p->acct.maxdelay);
+    shell_output_str(&pstat_command, (char *)PROCESS_NAME_STRING(p), buf);
+  }
+
+  PROCESS_END();
+}
+#endif /* PROCESS_CONF_ACCOUNTING */
+/*---------------------------------------------------------------------------*/
 void
 shell_ps_init(void)
 {
   shell_register_command(&ps_command);
+#if PROCESS_CONF_ACCOUNTING
+  shell_register_command(&pstat_command);
+#endif /* PROCESS_CONF_ACCOUNTING */
 }
 /*---------------------------------------------------------------------------*/
@@ -54,11 +54,36 @@ memb_init(struct memb *m)
 {
   memset(m->count, 0, m->num);
   memset(m->mem, 0, m->size * m->num);
+#if MEMB_CONF_FREELIST
+  m->freelist = m->fresh = 0;
+  m->used = m->maxused = m->failed = 0;
+#endif /* MEMB_CONF_FREELIST */
 }
 /*---------------------------------------------------------------------------*/
 void *
 memb_alloc(struct memb *m)
 {
+#if MEMB_CONF_FREELIST
+  unsigned short i;
+
+  if(m->freelist != 0) {
+    /* Take the first block on the free list. */
+    i = m->freelist - 1;
+    m->freelist = m->next[i];
+  } else if(m->fresh < m->num) {
+    /* Take a block that has never been used. */
+    i = m->fresh++;
+  } else {
+    ++m->failed;
+    return NULL;
+  }
+
+  m->count[i] = 1;
+  if(++m->used > m->maxused) {
+    m->maxused = m->used;
+  }
+  return (void *)((char *)m->mem + (i * m->size));
+#else /* MEMB_CONF_FREELIST */
   int i;
 
   for(i = 0; i < m->num; ++i) {
@@ -74,11 +99,37 @@ memb_alloc(struct memb *m)
   /* No free block was found, so we return NULL to indicate failure to
      allocate block. */
   return NULL;
+#endif /* MEMB_CONF_FREELIST */
 }
 /*---------------------------------------------------------------------------*/
 char
 memb_free(struct memb *m, void *ptr)
 {
+#if MEMB_CONF_FREELIST
+  unsigned short i;
+  unsigned long offset;
+
+  /* Compute the block number from the pointer instead of searching
+     for it. */
+  if(!memb_inmemb(m, ptr)) {
+    return -1;
+  }
+  offset = (char *)ptr - (char *)m->mem;
+  i = offset / m->size;
+  if(offset != (unsigned long)i * m->size) {
+    return -1;
+  }
+
+  if(m->count[i] > 0) {
+    /* Make sure that we don't deallocate free memory. */
+    if(--(m->count[i]) == 0) {
+      m->next[i] = m->freelist;
+      m->freelist = i + 1;
+      --m->used;
+    }
+  }
+  return m->count[i];
+#else /* MEMB_CONF_FREELIST */
   int i;
   char *ptr2;
 
@@ -99,6 +150,7 @@ memb_free(struct memb *m, void *ptr)
     ptr2 += m->size;
   }
   return -1;
+#endif /* MEMB_CONF_FREELIST */
 }
 /*---------------------------------------------------------------------------*/
 int
@@ -64,8 +64,20 @@
 #ifndef __MEMB_H__
 #define __MEMB_H__
 
+#include "contiki-conf.h"
 #include "sys/cc.h"
 
+/**
+ * When MEMB_CONF_FREELIST is set, each memory block set keeps a list
+ * of free blocks so that memb_alloc() and memb_free() run in constant
+ * time, and keeps counters of the blocks in use, the high-water mark
+ * and the number of failed allocations. The API is the same, but each
+ * block costs two more bytes of RAM.
+ */
+#ifndef MEMB_CONF_FREELIST
+#define MEMB_CONF_FREELIST 0
+#endif /* MEMB_CONF_FREELIST */
+
 /**
  * Declare a memory block.
  *
@@ -87,18 +99,41 @@ MEMB(connections, struct connection, 16);
  * \param num The total number of memory chunks in the block.
  *
  */
+#if MEMB_CONF_FREELIST
+#define MEMB(name, structure, num) \
+        static char CC_CONCAT(name,_memb_count)[num]; \
+        static structure CC_CONCAT(name,_memb_mem)[num]; \
+        static unsigned short CC_CONCAT(name,_memb_next)[num]; \
+        static struct memb name = {sizeof(structure), num, \
+                                          CC_CONCAT(name,_memb_count), \
+                                          (void *)CC_CONCAT(name,_memb_mem), \
+                                          CC_CONCAT(name,_memb_next)}
+#else /* MEMB_CONF_FREELIST */
 #define MEMB(name, structure, num) \
         static char CC_CONCAT(name,_memb_count)[num]; \
         static structure CC_CONCAT(name,_memb_mem)[num]; \
         static struct memb name = {sizeof(structure), num, \
                                           CC_CONCAT(name,_memb_count), \
                                           (void *)CC_CONCAT(name,_memb_mem)}
+#endif /* MEMB_CONF_FREELIST */
 
 struct memb {
   unsigned short size;
   unsigned short num;
   char *count;
   void *mem;
+#if MEMB_CONF_FREELIST
+  /* Free list links. Blocks are numbered from 1 and 0 ends the list. */
+  unsigned short *next;
+  /* The first block on the free list. */
+  unsigned short freelist;
+  /* Blocks from this index on have never been allocated, which makes
+     a zero initialized memb valid without a free list. */
+  unsigned short fresh;
+  /* Statistics: blocks in use, most blocks in use at the same time,
+     and allocations that failed because no block was free. */
+  unsigned short used, maxused, failed;
+#endif /* MEMB_CONF_FREELIST */
 };
 
 /**
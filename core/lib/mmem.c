@@ -56,10 +56,25 @@
 #define MMEM_SIZE 4096
 #endif
 
+#ifdef MMEM_CONF_DEFERRED_COMPACTION
+#define MMEM_DEFERRED_COMPACTION MMEM_CONF_DEFERRED_COMPACTION
+#else
+#define MMEM_DEFERRED_COMPACTION 0
+#endif
+
 LIST(mmemlist);
 unsigned int avail_memory;
 static char memory[MMEM_SIZE];
 
+struct mmem_stats mmem_stats;
+
+#if MMEM_DEFERRED_COMPACTION
+/* The first byte after the last allocated block. Blocks are kept in
+   address order, and freed blocks leave holes below this point until
+   the memory is compacted. */
+static char *memory_end;
+#endif /* MMEM_DEFERRED_COMPACTION */
+
 /*---------------------------------------------------------------------------*/
 /**
  * \brief      Allocate a managed memory block
@@ -88,13 +103,26 @@ mmem_alloc(struct mmem *m, unsigned int size)
     return 0;
   }
 
+#if MMEM_DEFERRED_COMPACTION
+  /* There is enough free memory, but it may be in holes left by
+     freed blocks. Compact the memory if the holes are needed. */
+  if((unsigned int)(&memory[MMEM_SIZE] - memory_end) < size) {
+    mmem_compact(0);
+  }
+#endif /* MMEM_DEFERRED_COMPACTION */
+
   /* We had enough memory so we add this memory block to the end of
      the list of allocated memory blocks. */
   list_add(mmemlist, m);
 
   /* Set up the pointer so that it points to the first available byte
      in the memory block. */
+#if MMEM_DEFERRED_COMPACTION
+  m->ptr = memory_end;
+  memory_end += size;
+#else /* MMEM_DEFERRED_COMPACTION */
   m->ptr = &memory[MMEM_SIZE - avail_memory];
+#endif /* MMEM_DEFERRED_COMPACTION */
 
   /* Remember the size of this memory block. */
   m->size = size;
@@ -121,11 +149,26 @@ mmem_free(struct mmem *m)
 {
   struct mmem *n;
 
+#if MMEM_DEFERRED_COMPACTION
+  /* Leave a hole that is reclaimed by mmem_compact(). Only if the
+     last block is freed does the end of the used memory move down. */
+  avail_memory += m->size;
+  if(m->next == NULL) {
+    list_remove(mmemlist, m);
+    n = list_tail(mmemlist);
+    memory_end = n != NULL ? (char *)n->ptr + n->size : memory;
+  } else {
+    list_remove(mmemlist, m);
+  }
+#else /* MMEM_DEFERRED_COMPACTION */
   if(m->next != NULL) {
     /* Compact the memory after the allocation that is to be removed
        by moving it downwards. */
     memmove(m->ptr, m->next->ptr,
 	    &memory[MMEM_SIZE - avail_memory] - (char *)m->next->ptr);
+    ++mmem_stats.compactions;
+    mmem_stats.moved += &memory[MMEM_SIZE - avail_memory] -
+      (char *)m->next->ptr;
     
     /* Update all the memory pointers that points to memory that is
        after the allocation that is to be removed. */
@@ -138,6 +181,7 @@ mmem_free(struct mmem *m)
 
   /* Remove the memory block from the list. */
   list_remove(mmemlist, m);
+#endif /* MMEM_DEFERRED_COMPACTION */
 }
 /*---------------------------------------------------------------------------*/
 /**
@@ -154,6 +198,78 @@ mmem_init(void)
 {
   list_init(mmemlist);
   avail_memory = MMEM_SIZE;
+#if MMEM_DEFERRED_COMPACTION
+  memory_end = memory;
+#endif /* MMEM_DEFERRED_COMPACTION */
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief      Compact the managed memory
+ * \param maxmove The maximum number of bytes to move, or 0 to
+ *             compact all memory
+ * \return     Non-zero if there are holes left in the memory, zero
+ *             if the memory is compact.
+ *
+ *             With MMEM_CONF_DEFERRED_COMPACTION, freed blocks leave
+ *             holes that are only reclaimed when an allocation needs
+ *             them. This function moves blocks down into the holes,
+ *             and can be called with a small maxmove when the system
+ *             is idle to compact the memory in bounded steps. At least
+ *             one block is moved per call, even if it is larger than
+ *             maxmove. Without deferred compaction the memory always
+ *             is compact and the function does nothing.
+ *
+ */
+int
+mmem_compact(unsigned int maxmove)
+{
+#if MMEM_DEFERRED_COMPACTION
+  struct mmem *n;
+  char *to;
+  unsigned int moved;
+
+  to = memory;
+  moved = 0;
+  for(n = list_head(mmemlist); n != NULL; n = n->next) {
+    if(n->ptr != to) {
+      if(maxmove > 0 && moved > 0 && moved + n->size > maxmove) {
+	break;
+      }
+      memmove(to, n->ptr, n->size);
+      n->ptr = to;
+      moved += n->size;
+    }
+    to += n->size;
+  }
+
+  if(moved > 0) {
+    ++mmem_stats.compactions;
+    mmem_stats.moved += moved;
+  }
+
+  if(n != NULL) {
+    return 1;
+  }
+  memory_end = to;
+#endif /* MMEM_DEFERRED_COMPACTION */
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * \brief      Get the amount of fragmented memory
+ * \return     The number of free bytes that are in holes between
+ *             allocated blocks and therefore not available to an
+ *             allocation without compaction.
+ *
+ */
+unsigned int
+mmem_fragmented(void)
+{
+#if MMEM_DEFERRED_COMPACTION
+  return avail_memory - (&memory[MMEM_SIZE] - memory_end);
+#else /* MMEM_DEFERRED_COMPACTION */
+  return 0;
+#endif /* MMEM_DEFERRED_COMPACTION */
 }
 /*---------------------------------------------------------------------------*/
 
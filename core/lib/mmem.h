@@ -84,9 +84,23 @@ struct mmem {
 /* XXX: tagga minne med "interrupt usage", vilke gr att man r
    speciellt varsam under free(). */
 
+/**
+ * Statistics for the managed memory allocator.
+ */
+struct mmem_stats {
+  /** The number of times memory was moved to close holes. */
+  unsigned long compactions;
+  /** The total number of bytes moved by compaction. */
+  unsigned long moved;
+};
+
+extern struct mmem_stats mmem_stats;
+
 int  mmem_alloc(struct mmem *m, unsigned int size);
 void mmem_free(struct mmem *);
 void mmem_init(void);
+int  mmem_compact(unsigned int maxmove);
+unsigned int mmem_fragmented(void);
 
 #endif /* __MMEM_H__ */
 
@@ -105,6 +105,7 @@ rpl_add_route(rpl_dag_t *dag, uip_ipaddr_t *prefix, int prefix_len,
     PRINT6ADDR(next_hop);
     PRINTF("\n");
     uip_ipaddr_copy(&rep->nexthop, next_hop);
+    uip_ds6_nexthop_changed = 1;
   }
   rep->state.dag = dag;
   rep->state.lifetime = DEFAULT_ROUTE_LIFETIME;
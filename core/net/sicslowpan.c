@@ -210,35 +210,51 @@ static u8_t uncomp_hdr_len;
  *  @{
  */
 
-static uint16_t sicslowpan_len;
-
 /**
- * The buffer used for the 6lowpan reassembly.
- * This buffer contains only the IPv6 packet (no MAC header, 6lowpan, etc).
- * It has a fix size as we do not use dynamic memory allocation.
+ * A 6lowpan reassembly slot.
+ * It holds the IPv6 packet (no MAC header, 6lowpan, etc) being
+ * reassembled from the fragments one sender sent with one datagram
+ * tag. The slots have a fix size as we do not use dynamic memory
+ * allocation. With the uIP buffer pool, a slot takes a buffer from
+ * the pool instead, which becomes uip_buf once the packet is
+ * complete.
  */
-static uip_buf_t sicslowpan_aligned_buf;
-#define sicslowpan_buf (sicslowpan_aligned_buf.u8)
+struct sicslowpan_reass {
+#if UIP_BUFFER_POOL
+  struct uip_pbuf *pbuf;
+#else /* UIP_BUFFER_POOL */
+  uip_buf_t buf;
+#endif /* UIP_BUFFER_POOL */
+  /** The source address of the fragments being merged */
+  rimeaddr_t sender;
+  /** Reassembly timer */
+  struct timer timer;
+  /** The total length of the IPv6 packet, 0 if the slot is free */
+  uint16_t len;
+  /**
+   * length of the ip packet already received.
+   * It includes IP and transport headers.
+   */
+  uint16_t processed_ip_len;
+  /** The tag in the fragments being merged */
+  uint16_t tag;
+};
 
-/** The total length of the IPv6 packet in the sicslowpan_buf. */
+static struct sicslowpan_reass reass_slots[SICSLOWPAN_CONF_REASS_CONTEXTS];
 
 /**
- * length of the ip packet already sent / received.
- * It includes IP and transport headers.
+ * The buffer a received packet is uncompressed into: the reassembly
+ * slot of a fragment, or uip_buf if the packet is not fragmented.
  */
-static uint16_t processed_ip_len;
+static uip_buf_t *sicslowpan_bufp;
+#define sicslowpan_buf (sicslowpan_bufp->u8)
 
 /** Datagram tag to be put in the fragments I send. */
 static uint16_t my_tag;
 
-/** When reassembling, the tag in the fragments being merged. */
-static uint16_t reass_tag;
-
-/** When reassembling, the source address of the fragments being merged */
-rimeaddr_t frag_sender;
-
-/** Reassembly %process %timer. */
-static struct timer reass_timer;
+#if UIP_STATISTICS
+struct sicslowpan_reass_stats sicslowpan_reass_stats;
+#endif /* UIP_STATISTICS */
 
 /** @} */
 #else /* SICSLOWPAN_CONF_FRAG */
@@ -1246,14 +1262,12 @@ packet_sent(void *ptr, int status, int transmissions)
 }
 /*--------------------------------------------------------------------*/
 /**
- * \brief This function is called by the 6lowpan code to send out a
- * packet.
+ * \brief Set the link layer addresses of the packet in packetbuf
  * \param dest the link layer destination address of the packet
  */
 static void
-send_packet(rimeaddr_t *dest)
+set_packet_addrs(rimeaddr_t *dest)
 {
-
   /* Set the link layer destination address for the packet as a
    * packetbuf attribute. The MAC layer can access the destination
    * address with the function packetbuf_addr(PACKETBUF_ADDR_RECEIVER).
@@ -1267,7 +1281,18 @@ send_packet(rimeaddr_t *dest)
 #if SICSLOWPAN_CONF_ACK_ALL
     packetbuf_set_attr(PACKETBUF_ATTR_RELIABLE, 1);
 #endif
-  
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief This function is called by the 6lowpan code to send out a
+ * packet.
+ * \param dest the link layer destination address of the packet
+ */
+static void
+send_packet(rimeaddr_t *dest)
+{
+  set_packet_addrs(dest);
+
   /* Provide a callback function to receive the result of
      a packet transmission. */
   NETSTACK_MAC.send(&packet_sent, NULL);
@@ -1276,6 +1301,79 @@ send_packet(rimeaddr_t *dest)
      watchdog know that we are still alive. */
   watchdog_periodic();
 }
+/*--------------------------------------------------------------------*/
+#if SICSLOWPAN_CONF_FRAG && SICSLOWPAN_CONF_FRAG_PIPELINE
+/** \name Fragment train
+ *
+ * All fragments of a datagram are built into queuebufs before the
+ * first one is sent. They are then handed to the MAC
+ * SICSLOWPAN_CONF_FRAG_PIPELINE at a time, the next one going out as
+ * soon as the MAC reports on an earlier one. When a fragment fails,
+ * the receiver cannot reassemble the datagram anyway, so the
+ * fragments not yet handed to the MAC are dropped.
+ *  @{
+ */
+#define FRAG_TRAIN_MAX ((UIP_BUFSIZE - UIP_LLH_LEN) / \
+                        ((MAC_MAX_PAYLOAD - SICSLOWPAN_FRAGN_HDR_LEN) & 0xf8) + 2)
+
+static struct {
+  struct queuebuf *frags[FRAG_TRAIN_MAX];
+  /** Fragments in the train, 0 if no train is being sent */
+  uint8_t count;
+  /** The next fragment to hand to the MAC */
+  uint8_t next;
+  /** Fragments handed to the MAC that it has not reported on yet */
+  uint8_t pending;
+} frag_train;
+
+static void frag_train_send(void);
+/** @} */
+/*--------------------------------------------------------------------*/
+static void
+frag_train_drop(void)
+{
+  while(frag_train.next < frag_train.count) {
+    queuebuf_free(frag_train.frags[frag_train.next++]);
+  }
+  if(frag_train.pending == 0) {
+    frag_train.count = frag_train.next = 0;
+  }
+}
+/*--------------------------------------------------------------------*/
+static void
+frag_sent(void *ptr, int status, int transmissions)
+{
+  packet_sent(ptr, status, transmissions);
+
+  frag_train.pending--;
+  if(status != MAC_TX_OK && frag_train.next < frag_train.count) {
+    PRINTFO("sicslowpan output: fragment failed (%d), dropping %d more\n",
+            status, frag_train.count - frag_train.next);
+    frag_train_drop();
+  } else if(frag_train.next < frag_train.count) {
+    frag_train_send();
+  } else if(frag_train.pending == 0) {
+    frag_train.count = frag_train.next = 0;
+  }
+}
+/*--------------------------------------------------------------------*/
+static void
+frag_train_send(void)
+{
+  struct queuebuf *q;
+
+  while(frag_train.next < frag_train.count &&
+        frag_train.pending < SICSLOWPAN_CONF_FRAG_PIPELINE) {
+    q = frag_train.frags[frag_train.next++];
+    queuebuf_to_packetbuf(q);
+    queuebuf_free(q);
+    frag_train.pending++;
+    /* The MAC may report back before it returns */
+    NETSTACK_MAC.send(&frag_sent, NULL);
+    watchdog_periodic();
+  }
+}
+#endif /* SICSLOWPAN_CONF_FRAG && SICSLOWPAN_CONF_FRAG_PIPELINE */
 
 /** \brief Take an IP packet and format it to be sent on an 802.15.4
  *  network using 6lowpan.
@@ -1291,7 +1389,12 @@ output(uip_lladdr_t *localdest)
 {
   /* The MAC address of the destination of the packet */
   rimeaddr_t dest;
+#if SICSLOWPAN_CONF_FRAG
   u16_t processed_ip_len; // Redefined here in local scope so as to not interfere with inbound fragment reassembly.
+#endif /* SICSLOWPAN_CONF_FRAG */
+#if SICSLOWPAN_CONF_FRAG && SICSLOWPAN_CONF_FRAG_PIPELINE
+  uint8_t pipelined;
+#endif /* SICSLOWPAN_CONF_FRAG && SICSLOWPAN_CONF_FRAG_PIPELINE */
   
 
   /* init */
@@ -1362,6 +1465,16 @@ output(uip_lladdr_t *localdest)
 
 
     PRINTFO("Fragmentation sending packet len %d\n", uip_len);
+#if SICSLOWPAN_CONF_FRAG_PIPELINE
+    /* While the fragments of an earlier datagram are still going out,
+       this one is sent one fragment at a time as without the train */
+    pipelined = frag_train.count == 0;
+    if(pipelined) {
+      set_packet_addrs(&dest);
+    } else {
+      PRINTFO("sicslowpan output: still sending previous fragments, not pipelining\n");
+    }
+#endif /* SICSLOWPAN_CONF_FRAG_PIPELINE */
     
     /* Create 1st Fragment */
     PRINTFO("sicslowpan output: 1rst fragment ");
@@ -1392,9 +1505,16 @@ output(uip_lladdr_t *localdest)
       PRINTFO("could not allocate queuebuf for first fragment, dropping packet\n");
       return 0;
     }
-    send_packet(&dest);
-    queuebuf_to_packetbuf(q);
-    queuebuf_free(q);
+#if SICSLOWPAN_CONF_FRAG_PIPELINE
+    if(pipelined) {
+      frag_train.frags[frag_train.count++] = q;
+    } else
+#endif /* SICSLOWPAN_CONF_FRAG_PIPELINE */
+    {
+      send_packet(&dest);
+      queuebuf_to_packetbuf(q);
+      queuebuf_free(q);
+    }
     q = NULL;
 
     /* set processed_ip_len to what we already sent from the IP payload*/
@@ -1427,16 +1547,36 @@ output(uip_lladdr_t *localdest)
       packetbuf_set_datalen(rime_payload_len + rime_hdr_len);
       q = queuebuf_new_from_packetbuf();
       if(q == NULL) {
+#if SICSLOWPAN_CONF_FRAG_PIPELINE
+        if(pipelined) {
+          PRINTFO("could not allocate queuebuf, dropping packet\n");
+          frag_train_drop();
+          return 0;
+        }
+#endif /* SICSLOWPAN_CONF_FRAG_PIPELINE */
         PRINTFO("could not allocate queuebuf, dropping fragment\n");
         return 0;
       }
-      send_packet(&dest);
-      queuebuf_to_packetbuf(q);
-      queuebuf_free(q);
+#if SICSLOWPAN_CONF_FRAG_PIPELINE
+      if(pipelined) {
+        frag_train.frags[frag_train.count++] = q;
+      } else
+#endif /* SICSLOWPAN_CONF_FRAG_PIPELINE */
+      {
+        send_packet(&dest);
+        queuebuf_to_packetbuf(q);
+        queuebuf_free(q);
+      }
       q = NULL;
       processed_ip_len += rime_payload_len;
     }
     
+#if SICSLOWPAN_CONF_FRAG_PIPELINE
+    if(pipelined) {
+      frag_train_send();
+    }
+#endif /* SICSLOWPAN_CONF_FRAG_PIPELINE */
+
     /* end: reset global variables  */
     my_tag++;
     processed_ip_len = 0;
@@ -1457,6 +1597,90 @@ output(uip_lladdr_t *localdest)
   return 1;
 }
 
+/*--------------------------------------------------------------------*/
+#if SICSLOWPAN_CONF_FRAG
+/** \brief Free a reassembly slot and its buffer */
+static void
+reass_free(struct sicslowpan_reass *r)
+{
+#if UIP_BUFFER_POOL
+  uip_pbuf_free(r->pbuf);
+  r->pbuf = NULL;
+#endif /* UIP_BUFFER_POOL */
+  r->len = 0;
+}
+/*--------------------------------------------------------------------*/
+/**
+ * \brief Find the reassembly slot of a received fragment
+ * \param tag The datagram tag of the fragment
+ * \param size The datagram size of the fragment
+ * \param first Non-zero if this is the first fragment
+ * \return The slot, or NULL if the fragment must be dropped
+ *
+ * Fragments are matched on link-layer sender and datagram tag. A
+ * fragment of a new datagram takes a free slot. Slots whose timer
+ * expired are freed here. A first fragment with a new tag also frees
+ * the slots of the same sender, which gave up on its previous
+ * packet.
+ */
+static struct sicslowpan_reass *
+reass_lookup(uint16_t tag, uint16_t size, uint8_t first)
+{
+  struct sicslowpan_reass *r, *found = NULL, *unused = NULL;
+  const rimeaddr_t *sender = packetbuf_addr(PACKETBUF_ADDR_SENDER);
+
+  for(r = reass_slots; r < &reass_slots[SICSLOWPAN_CONF_REASS_CONTEXTS]; r++) {
+    if(r->len > 0 && timer_expired(&r->timer)) {
+      PRINTFI("sicslowpan input: reassembly timed out (tag %d)\n", r->tag);
+      UIP_STAT(++sicslowpan_reass_stats.timedout);
+      reass_free(r);
+    }
+    if(r->len > 0 && rimeaddr_cmp(&r->sender, sender)) {
+      if(r->tag == tag) {
+        found = r;
+      } else if(first) {
+        PRINTFI("sicslowpan input: Got start of new fragmented packet, dropping previous packet.\n");
+        UIP_STAT(++sicslowpan_reass_stats.aborted);
+        reass_free(r);
+      }
+    }
+    if(r->len == 0 && unused == NULL) {
+      unused = r;
+    }
+  }
+
+  if(found != NULL) {
+    if(found->len != size) {
+      PRINTFI("sicslowpan input: Dropping fragment with wrong size\n");
+      UIP_STAT(++sicslowpan_reass_stats.dropped);
+      return NULL;
+    }
+    return found;
+  }
+  if(unused == NULL) {
+    PRINTFI("sicslowpan input: Dropping fragment, all reassembly slots busy\n");
+    UIP_STAT(++sicslowpan_reass_stats.dropped);
+    return NULL;
+  }
+#if UIP_BUFFER_POOL
+  unused->pbuf = uip_pbuf_alloc();
+  if(unused->pbuf == NULL) {
+    PRINTFI("sicslowpan input: Dropping fragment, no free buffer\n");
+    UIP_STAT(++sicslowpan_reass_stats.dropped);
+    return NULL;
+  }
+#endif /* UIP_BUFFER_POOL */
+
+  unused->len = size;
+  unused->processed_ip_len = 0;
+  unused->tag = tag;
+  rimeaddr_copy(&unused->sender, sender);
+  timer_set(&unused->timer, SICSLOWPAN_REASS_MAXAGE*CLOCK_SECOND);
+  PRINTFI("sicslowpan input: INIT FRAGMENTATION (len %d, tag %d)\n",
+          size, tag);
+  return unused;
+}
+#endif /* SICSLOWPAN_CONF_FRAG */
 /*--------------------------------------------------------------------*/
 /** \brief Process a received 6lowpan packet.
  *  \param r The MAC layer
@@ -1465,7 +1689,8 @@ output(uip_lladdr_t *localdest)
  *  a non-fragmented packet we first uncompress the IP header. The
  *  6lowpan payload and possibly the uncompressed IP header are then
  *  copied in siclowpan_buf. If the IP packet is complete it is copied
- *  to uip_buf and the IP layer is called.
+ *  to uip_buf, or with the uIP buffer pool its buffer becomes uip_buf,
+ *  and the IP layer is called.
  *
  * \note We do not check for overlapping sicslowpan fragments
  * (it is a SHALL in the RFC 4944 and should never happen)
@@ -1481,6 +1706,7 @@ input(void)
   /* tag of the fragment */
   uint16_t frag_tag = 0;
   uint8_t first_fragment = 0;
+  struct sicslowpan_reass *reass = NULL;
 #endif /*SICSLOWPAN_CONF_FRAG*/
 
   /* init */
@@ -1491,11 +1717,6 @@ input(void)
   rime_ptr = packetbuf_dataptr();
 
 #if SICSLOWPAN_CONF_FRAG
-  /* if reassembly timed out, cancel it */
-  if(timer_expired(&reass_timer)) {
-    sicslowpan_len = 0;
-    processed_ip_len = 0;
-  }
   /*
    * Since we don't support the mesh and broadcast header, the first header
    * we look for is the fragmentation header
@@ -1531,42 +1752,23 @@ input(void)
       break;
   }
 
-  if(processed_ip_len > 0) {
-    /* reassembly is ongoing */
-    /*    printf("frag %d %d\n", reass_tag, frag_tag);*/
-    if((reass_tag  != frag_tag)
-	   && (frag_offset==0)
-	   && rimeaddr_cmp(&frag_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER))
-	) {
-      PRINTFI("sicslowpan input: Got start of new fragmented packet, dropping previous packet.\n");
-	  processed_ip_len = 0;
-	  sicslowpan_len = 0;
-	} else
-    if((frag_size > 0 &&
-        (frag_size != sicslowpan_len ||
-         reass_tag  != frag_tag ||
-         !rimeaddr_cmp(&frag_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER))))  ||
-       frag_size == 0) {
-      /*
-       * the packet is a fragment that does not belong to the packet
-       * being reassembled or the packet is not a fragment.
-       */
-      PRINTFI("sicslowpan input: Dropping 6lowpan packet that is not a fragment of the packet currently being reassembled\n");
+  if(frag_size > 0) {
+    if(frag_size > UIP_BUFSIZE - UIP_LLH_LEN) {
+      PRINTFI("sicslowpan input: fragmented packet too large (%d)\n", frag_size);
       return;
     }
-  } else if(processed_ip_len == 0) {
-    /*
-     * reassembly is off
-     * start it if we received a fragment
-     */
-    if(frag_size > 0) {
-      sicslowpan_len = frag_size;
-      reass_tag = frag_tag;
-      timer_set(&reass_timer, SICSLOWPAN_REASS_MAXAGE*CLOCK_SECOND);
-      PRINTFI("sicslowpan input: INIT FRAGMENTATION (len %d, tag %d)\n",
-             sicslowpan_len, reass_tag);
-      rimeaddr_copy(&frag_sender, packetbuf_addr(PACKETBUF_ADDR_SENDER));
+    reass = reass_lookup(frag_tag, frag_size, first_fragment);
+    if(reass == NULL) {
+      return;
     }
+#if UIP_BUFFER_POOL
+    sicslowpan_bufp = &reass->pbuf->buf;
+#else /* UIP_BUFFER_POOL */
+    sicslowpan_bufp = &reass->buf;
+#endif /* UIP_BUFFER_POOL */
+  } else {
+    /* Not a fragment: uncompress it straight into uip_buf */
+    sicslowpan_bufp = &uip_aligned_buf;
   }
 
   if(rime_hdr_len == SICSLOWPAN_FRAGN_HDR_LEN) {
@@ -1623,56 +1825,66 @@ input(void)
     return;
   }
   rime_payload_len = packetbuf_datalen() - rime_hdr_len;
+  if(uncomp_hdr_len + (uint16_t)(frag_offset << 3) + rime_payload_len >
+     UIP_BUFSIZE - UIP_LLH_LEN) {
+    PRINTF("SICSLOWPAN: packet dropped, it does not fit the buffer\n");
+    return;
+  }
   memcpy((uint8_t *)SICSLOWPAN_IP_BUF + uncomp_hdr_len + (uint16_t)(frag_offset << 3), rime_ptr + rime_hdr_len, rime_payload_len);
   
-  /* update processed_ip_len if fragment, sicslowpan_len otherwise */
+  /* update processed_ip_len if fragment, uip_len otherwise */
 
 #if SICSLOWPAN_CONF_FRAG
   if(frag_size > 0) {
     /* Add the size of the header only for the first fragment. */
     if(first_fragment != 0) {
-      processed_ip_len += uncomp_hdr_len;
+      reass->processed_ip_len += uncomp_hdr_len;
     }
-    processed_ip_len += rime_payload_len;
-  } else {
-#endif /* SICSLOWPAN_CONF_FRAG */
-    sicslowpan_len = rime_payload_len + uncomp_hdr_len;
-#if SICSLOWPAN_CONF_FRAG
-  }
+    reass->processed_ip_len += rime_payload_len;
 
-  /*
-   * If we have a full IP packet in sicslowpan_buf, deliver it to
-   * the IP stack
-   */
-  if(processed_ip_len == 0 || (processed_ip_len == sicslowpan_len)) {
-    PRINTFI("sicslowpan input: IP packet ready (length %d)\n",
-           sicslowpan_len);
-    memcpy((uint8_t *)UIP_IP_BUF, (uint8_t *)SICSLOWPAN_IP_BUF, sicslowpan_len);
-    uip_len = sicslowpan_len;
-    sicslowpan_len = 0;
-    processed_ip_len = 0;
+    /*
+     * If we have a full IP packet in the reassembly slot, deliver it to
+     * the IP stack
+     */
+    if(reass->processed_ip_len != reass->len) {
+      return;
+    }
+    PRINTFI("sicslowpan input: IP packet ready (length %d)\n", reass->len);
+#if UIP_BUFFER_POOL
+    /* The slot's buffer becomes uip_buf, nothing is copied */
+    reass->pbuf->len = reass->len;
+    uip_pbuf_attach(reass->pbuf);
+    reass->pbuf = NULL;
+#else /* UIP_BUFFER_POOL */
+    memcpy((uint8_t *)UIP_IP_BUF, (uint8_t *)SICSLOWPAN_IP_BUF, reass->len);
+    uip_len = reass->len;
+#endif /* UIP_BUFFER_POOL */
+    reass->len = 0;
+    UIP_STAT(++sicslowpan_reass_stats.reassembled);
+  } else
 #endif /* SICSLOWPAN_CONF_FRAG */
+  {
+    /* The packet was uncompressed in uip_buf */
+    uip_len = rime_payload_len + uncomp_hdr_len;
+  }
 
 #if DEBUG
-    {
-      uint8_t tmp;
-      PRINTF("after decompression: ");
-      for (tmp = 0; tmp < SICSLOWPAN_IP_BUF->len[1] + 40; tmp++) {
-	uint8_t data = ((uint8_t *) (SICSLOWPAN_IP_BUF))[tmp];
-	PRINTF("%02x", data);
-      }
-      PRINTF("\n");
+  {
+    uint8_t tmp;
+    PRINTF("after decompression: ");
+    for (tmp = 0; tmp < UIP_IP_BUF->len[1] + 40; tmp++) {
+      uint8_t data = ((uint8_t *) (UIP_IP_BUF))[tmp];
+      PRINTF("%02x", data);
     }
+    PRINTF("\n");
+  }
 #endif
 
 #if SICSLOWPAN_CONF_NEIGHBOR_INFO
-    neighbor_info_packet_received();
+  neighbor_info_packet_received();
 #endif /* SICSLOWPAN_CONF_NEIGHBOR_INFO */
 
-    tcpip_input();
-#if SICSLOWPAN_CONF_FRAG
-  }
-#endif /* SICSLOWPAN_CONF_FRAG */
+  tcpip_input();
 }
 /** @} */
 
@@ -318,6 +318,20 @@ struct sicslowpan_nh_compressor {
 
 };
 
+#if SICSLOWPAN_CONF_FRAG && UIP_STATISTICS
+/** \brief 6lowpan reassembly statistics */
+struct sicslowpan_reass_stats {
+  uip_stats_t reassembled;      /**< Packets reassembled. */
+  uip_stats_t timedout;         /**< Reassemblies abandoned when their
+                                   timer ran out. */
+  uip_stats_t aborted;          /**< Reassemblies abandoned because the
+                                   sender started a new packet. */
+  uip_stats_t dropped;          /**< Fragments dropped because all slots
+                                   were busy or the size did not match. */
+};
+
+extern struct sicslowpan_reass_stats sicslowpan_reass_stats;
+#endif /* SICSLOWPAN_CONF_FRAG && UIP_STATISTICS */
 
 extern const struct network_driver sicslowpan_driver;
 
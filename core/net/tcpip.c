@@ -44,6 +44,8 @@
 #include "net/uip-split.h"
 
 #include "net/uip-packetqueue.h"
+#include "net/uip-udp-queue.h"
+#include "net/uip-sndwnd.h"
 
 #include <string.h>
 
@@ -91,11 +93,6 @@ process_event_t tcpip_icmp6_event;
 /*periodic check of active connections*/
 static struct etimer periodic;
 
-#if UIP_CONF_IPV6 && UIP_CONF_IPV6_REASSEMBLY
-/*timer for reassembly*/
-extern struct etimer uip_reass_timer;
-#endif
-
 #if UIP_TCP
 /**
  * \internal Structure for holding a TCP port and a process ID.
@@ -190,6 +187,21 @@ check_for_tcp_syn(void)
 }
 /*---------------------------------------------------------------------------*/
 static void
+sndwnd_refill(void)
+{
+#if UIP_TCP && UIP_TCP_SNDWND
+  /* uIP sends at most one segment each time it processes a
+     connection. If the connection just processed is sending data
+     and its send window still has room, we poll it again so that the
+     application can send the next segment right away. */
+  if(uip_len > 0 && uip_conn != NULL &&
+     uip_outstanding(uip_conn) && uip_sndwnd_room(uip_conn) > 0) {
+    tcpip_poll_tcp(uip_conn);
+  }
+#endif /* UIP_TCP && UIP_TCP_SNDWND */
+}
+/*---------------------------------------------------------------------------*/
+static void
 packet_input(void)
 {
 #if UIP_CONF_IP_FORWARD
@@ -200,6 +212,7 @@ packet_input(void)
       check_for_tcp_syn();
       uip_input();
       if(uip_len > 0) {
+        sndwnd_refill();
 #if UIP_CONF_TCP_SPLIT
         uip_split_output();
 #else /* UIP_CONF_TCP_SPLIT */
@@ -219,6 +232,7 @@ packet_input(void)
     check_for_tcp_syn();
     uip_input();
     if(uip_len > 0) {
+      sndwnd_refill();
 #if UIP_CONF_TCP_SPLIT
       uip_split_output();
 #else /* UIP_CONF_TCP_SPLIT */
@@ -411,6 +425,10 @@ eventhandler(process_event_t ev, process_data_t data)
           if(cptr->appstate.p == p) {
             cptr->appstate.p = PROCESS_NONE;
             cptr->tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_SNDWND
+            /* Give the segments in flight back to the shared pool */
+            uip_sndwnd_flush(cptr);
+#endif /* UIP_TCP_SNDWND */
           }
 	       
         }
@@ -423,7 +441,7 @@ eventhandler(process_event_t ev, process_data_t data)
         for(cptr = &uip_udp_conns[0];
             cptr < &uip_udp_conns[UIP_UDP_CONNS]; ++cptr) {
           if(cptr->appstate.p == p) {
-            cptr->lport = 0;
+            uip_udp_remove(cptr);
           }
         }
       
@@ -445,6 +463,7 @@ eventhandler(process_event_t ev, process_data_t data)
                  connections. */
               etimer_restart(&periodic);
               uip_periodic(i);
+              sndwnd_refill();
 #if UIP_CONF_IPV6
               tcpip_ipv6_output();
 #else
@@ -467,9 +486,7 @@ eventhandler(process_event_t ev, process_data_t data)
         /*
          * check the timer for reassembly
          */
-        if(data == &uip_reass_timer &&
-           etimer_expired(&uip_reass_timer)) {
-          uip_reass_over();
+        if(uip_reass_over(data)) {
           tcpip_ipv6_output();
         }
 #endif /* UIP_CONF_IPV6_REASSEMBLY */
@@ -502,6 +519,7 @@ eventhandler(process_event_t ev, process_data_t data)
     case TCP_POLL:
       if(data != NULL) {
         uip_poll_conn(data);
+        sndwnd_refill();
 #if UIP_CONF_IPV6
         tcpip_ipv6_output();
 #else /* UIP_CONF_IPV6 */
@@ -559,12 +577,74 @@ loopback_packet(void) {
 #endif
 /*---------------------------------------------------------------------------*/
 #if UIP_CONF_IPV6
+#ifdef UIP_CONF_IPV6_DEST_CACHE
+#define UIP_IPV6_DEST_CACHE UIP_CONF_IPV6_DEST_CACHE
+#else /* UIP_CONF_IPV6_DEST_CACHE */
+#define UIP_IPV6_DEST_CACHE 0
+#endif /* UIP_CONF_IPV6_DEST_CACHE */
+
+#if UIP_IPV6_DEST_CACHE
+/*
+ * The destination cache remembers the neighbor that the next hop
+ * determination picked for the most recent destinations. It is
+ * flushed whenever uip-ds6 reports a change that could alter a next
+ * hop, so a hit gives the same neighbor as a full determination.
+ */
+struct dest_entry {
+  uip_ipaddr_t ipaddr;
+  uip_ds6_nbr_t *nbr;
+};
+static struct dest_entry dest_cache[UIP_IPV6_DEST_CACHE];
+static uint8_t dest_victim;
+/*---------------------------------------------------------------------------*/
+static uip_ds6_nbr_t *
+dest_cache_lookup(uip_ipaddr_t *ipaddr)
+{
+  uint8_t i;
+
+  if(uip_ds6_nexthop_changed) {
+    for(i = 0; i < UIP_IPV6_DEST_CACHE; i++) {
+      dest_cache[i].nbr = NULL;
+    }
+    uip_ds6_nexthop_changed = 0;
+    return NULL;
+  }
+  for(i = 0; i < UIP_IPV6_DEST_CACHE; i++) {
+    if(dest_cache[i].nbr != NULL &&
+       uip_ipaddr_cmp(&dest_cache[i].ipaddr, ipaddr)) {
+      return dest_cache[i].nbr;
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+dest_cache_add(uip_ipaddr_t *ipaddr, uip_ds6_nbr_t *nbr)
+{
+  uip_ipaddr_copy(&dest_cache[dest_victim].ipaddr, ipaddr);
+  dest_cache[dest_victim].nbr = nbr;
+  if(++dest_victim == UIP_IPV6_DEST_CACHE) {
+    dest_victim = 0;
+  }
+}
+#endif /* UIP_IPV6_DEST_CACHE */
+/*---------------------------------------------------------------------------*/
+/* Where tcpip_ipv6_output() sent the last packet, if it sent it at
+   once, for tcpip_ipv6_output_again() */
+static enum {
+  LAST_NONE,
+  LAST_UNICAST,
+  LAST_MULTICAST
+} last_sent;
+static uip_lladdr_t last_lladdr;
+/*---------------------------------------------------------------------------*/
 void
 tcpip_ipv6_output(void)
 {
   uip_ds6_nbr_t *nbr = NULL;
-  uip_ipaddr_t* nexthop;
+  uip_ipaddr_t* nexthop = NULL;
   
+  last_sent = LAST_NONE;
   if(uip_len == 0) {
     return;
   }
@@ -588,51 +668,65 @@ tcpip_ipv6_output(void)
   if(!uip_is_addr_mcast(&UIP_IP_BUF->destipaddr)) {
     /* Next hop determination */
     nbr = NULL;
-    if(uip_ds6_is_addr_onlink(&UIP_IP_BUF->destipaddr)){
-      nexthop = &UIP_IP_BUF->destipaddr;
-    } else {
-      uip_ds6_route_t* locrt;
-      locrt = uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr);
-      if(locrt == NULL) {
-        if((nexthop = uip_ds6_defrt_choose()) == NULL) {
+#if UIP_IPV6_DEST_CACHE
+    nbr = dest_cache_lookup(&UIP_IP_BUF->destipaddr);
+#endif /* UIP_IPV6_DEST_CACHE */
+    if(nbr == NULL) {
+      if(uip_ds6_is_addr_onlink(&UIP_IP_BUF->destipaddr)){
+        nexthop = &UIP_IP_BUF->destipaddr;
+      } else {
+        uip_ds6_route_t* locrt;
+        locrt = uip_ds6_route_lookup(&UIP_IP_BUF->destipaddr);
+        if(locrt == NULL) {
+          if((nexthop = uip_ds6_defrt_choose()) == NULL) {
 #ifdef UIP_FALLBACK_INTERFACE
-	  UIP_FALLBACK_INTERFACE.output();
+	    UIP_FALLBACK_INTERFACE.output();
 #else
-          PRINTF("tcpip_ipv6_output: Destination off-link but no route\n");
+            PRINTF("tcpip_ipv6_output: Destination off-link but no route\n");
 #endif
-          uip_len = 0;
-          return;
+            uip_len = 0;
+            return;
+          }
+        } else {
+	  nexthop = &locrt->nexthop;
         }
-      } else {
-	nexthop = &locrt->nexthop;
       }
+      nbr = uip_ds6_nbr_lookup(nexthop);
+#if UIP_IPV6_DEST_CACHE
+      /* An incomplete default router may lose to another one once it
+         resolves, so only resolved neighbors are cached. */
+      if(nbr != NULL && nbr->state != NBR_INCOMPLETE) {
+        dest_cache_add(&UIP_IP_BUF->destipaddr, nbr);
+      }
+#endif /* UIP_IPV6_DEST_CACHE */
     }
     /* end of next hop determination */
-    if((nbr = uip_ds6_nbr_lookup(nexthop)) == NULL) {
+    if(nbr == NULL) {
       //      printf("add1 %d\n", nexthop->u8[15]);
       if((nbr = uip_ds6_nbr_add(nexthop, NULL, 0, NBR_INCOMPLETE)) == NULL) {
         //        printf("add n\n");
         uip_len = 0;
         return;
       } else {
-#if UIP_CONF_IPV6_QUEUE_PKT
-        /* copy outgoing pkt in the queuing buffer for later transmmit */
-        if(uip_packetqueue_alloc(&nbr->packethandle, UIP_DS6_NBR_PACKET_LIFETIME) != NULL) {
-          memcpy(uip_packetqueue_buf(&nbr->packethandle), UIP_IP_BUF, uip_len);
-          uip_packetqueue_set_buflen(&nbr->packethandle, uip_len);
-        }
-#endif
+        uip_ipaddr_t *nssrc = NULL;
+
       /* RFC4861, 7.2.2:
        * "If the source address of the packet prompting the solicitation is the
        * same as one of the addresses assigned to the outgoing interface, that
        * address SHOULD be placed in the IP Source Address of the outgoing
        * solicitation.  Otherwise, any one of the addresses assigned to the
        * interface should be used."*/
-       if(uip_ds6_is_my_addr(&UIP_IP_BUF->srcipaddr)){
-          uip_nd6_ns_output(&UIP_IP_BUF->srcipaddr, NULL, &nbr->ipaddr);
-        } else {
-          uip_nd6_ns_output(NULL, NULL, &nbr->ipaddr);
+        if(uip_ds6_is_my_addr(&UIP_IP_BUF->srcipaddr)){
+          nssrc = &UIP_IP_BUF->srcipaddr;
         }
+#if UIP_CONF_IPV6_QUEUE_PKT
+        /* queue outgoing pkt for later transmit; with a uIP buffer pool it
+           takes its buffer along, which nssrc still points into */
+        uip_packetqueue_push(&nbr->packethandle, UIP_DS6_NBR_PACKET_LIFETIME);
+#endif
+        uip_nd6_ns_output(nssrc, NULL, &nbr->ipaddr);
+        /* The NS went out through here as well */
+        last_sent = LAST_NONE;
 
         stimer_set(&(nbr->sendns), uip_ds6_if.retrans_timer / 1000);
         nbr->nscount = 1;
@@ -643,10 +737,7 @@ tcpip_ipv6_output(void)
 #if UIP_CONF_IPV6_QUEUE_PKT
         /* copy outgoing pkt in the queuing buffer for later transmmit and set
            the destination nbr to nbr */
-        if(uip_packetqueue_alloc(&nbr->packethandle, UIP_DS6_NBR_PACKET_LIFETIME) != NULL) {
-          memcpy(uip_packetqueue_buf(&nbr->packethandle), UIP_IP_BUF, uip_len);
-          uip_packetqueue_set_buflen(&nbr->packethandle, uip_len);
-        }
+        uip_packetqueue_push(&nbr->packethandle, UIP_DS6_NBR_PACKET_LIFETIME);
         /*        memcpy(nbr->queue_buf, UIP_IP_BUF, uip_len);
                   nbr->queue_buf_len = uip_len;*/
         uip_len = 0;
@@ -667,6 +758,13 @@ tcpip_ipv6_output(void)
       stimer_set(&(nbr->sendns),
                 uip_ds6_if.retrans_timer / 1000);
 
+#if UIP_CONF_IPV6_QUEUE_PKT
+      /* Packets queued for this neighbor were sent before this one,
+         which may be the newest of them, handed over by uip-nd6: this
+         packet takes the place of the oldest one at the tail of the
+         queue, and the oldest one goes out first. */
+      uip_packetqueue_swap(&nbr->packethandle);
+#endif /*UIP_CONF_IPV6_QUEUE_PKT*/
       tcpip_output(&(nbr->lladdr));
 
 
@@ -674,7 +772,8 @@ tcpip_ipv6_output(void)
       /* Send the queued packets from here, may not be 100% perfect though.
        * This happens in a few cases, for example when instead of receiving a
        * NA after sendiong a NS, you receive a NS with SLLAO: the entry moves
-       *to STALE, and you must both send a NA and the queued packet
+       *to STALE, and you must both send a NA and the queued packet.
+       * The rest of the queue, this packet last, goes out in order.
        */
       /*      if(nbr->queue_buf_len != 0) {
         uip_len = nbr->queue_buf_len;
@@ -682,14 +781,13 @@ tcpip_ipv6_output(void)
         nbr->queue_buf_len = 0;
         tcpip_output(&(nbr->lladdr));
         }*/
-      if(uip_packetqueue_buflen(&nbr->packethandle) != 0) {
-        uip_len = uip_packetqueue_buflen(&nbr->packethandle);
-        memcpy(UIP_IP_BUF, uip_packetqueue_buf(&nbr->packethandle), uip_len);
-        uip_packetqueue_free(&nbr->packethandle);
+      while(uip_packetqueue_pull(&nbr->packethandle)) {
         tcpip_output(&(nbr->lladdr));
       }
 #endif /*UIP_CONF_IPV6_QUEUE_PKT*/
 
+      last_sent = LAST_UNICAST;
+      memcpy(&last_lladdr, &nbr->lladdr, sizeof(uip_lladdr_t));
       uip_len = 0;
       return;
     }
@@ -697,10 +795,48 @@ tcpip_ipv6_output(void)
    
   /*multicast IP destination address */
   tcpip_output(NULL);
+  if(nbr == NULL) {
+    /* Not a packet that waits for address resolution */
+    last_sent = LAST_MULTICAST;
+  }
   uip_len = 0;
   uip_ext_len = 0;
    
 }
+/*---------------------------------------------------------------------------*/
+/*
+ * Send the packet in uip_buf to the next hop of the packet that
+ * tcpip_ipv6_output() sent just before, skipping the next hop
+ * determination and address resolution. This is only valid right
+ * after tcpip_ipv6_output(), and only for a packet to the same
+ * destination, so it is not part of the tcpip.h API: only the UDP
+ * batches of uip-udp-packet.c use it.
+ *
+ * Returns 0 if that packet was not sent at once, because it was
+ * queued for address resolution or dropped. The packet is then left
+ * in uip_buf.
+ */
+u8_t
+tcpip_ipv6_output_again(void)
+{
+  if(uip_len == 0 || uip_len > UIP_LINK_MTU) {
+    uip_len = 0;
+    return 1;
+  }
+  switch(last_sent) {
+  case LAST_UNICAST:
+    tcpip_output(&last_lladdr);
+    break;
+  case LAST_MULTICAST:
+    tcpip_output(NULL);
+    break;
+  default:
+    return 0;
+  }
+  uip_len = 0;
+  uip_ext_len = 0;
+  return 1;
+}
 #endif
 /*---------------------------------------------------------------------------*/
 #if UIP_UDP
@@ -729,6 +865,21 @@ tcpip_uipcall(void)
     ts = &uip_conn->appstate;
   } else {
     ts = &uip_udp_conn->appstate;
+#if UIP_UDP_QUEUE
+    /* A datagram for a connection with a receive queue waits there
+       for the application. The process is told once, and then takes
+       out all datagrams that it finds. If the event could not be
+       posted, the next datagram tries again. */
+    if(uip_udp_conn->queue != NULL && uip_newdata()) {
+      uip_udp_queue_input(uip_udp_conn->queue);
+      if(!uip_udp_conn->queue->posted && uip_udp_conn->queue->len > 0 &&
+         ts->p != NULL &&
+         process_post(ts->p, tcpip_event, ts->state) == PROCESS_ERR_OK) {
+        uip_udp_conn->queue->posted = 1;
+      }
+      return;
+    }
+#endif /* UIP_UDP_QUEUE */
   }
 #else /* UIP_UDP */
   ts = &uip_conn->appstate;
@@ -779,6 +930,10 @@ PROCESS_THREAD(tcpip_process, ev, data)
  }
 #endif
 
+  /* Network events are latency critical: have them delivered ahead
+     of application events when the kernel has several priorities. */
+  process_set_priority(PROCESS_CURRENT(), PROCESS_PRIO_HIGH);
+
   tcpip_event = process_alloc_event();
 #if UIP_CONF_ICMP6
   tcpip_icmp6_event = process_alloc_event();
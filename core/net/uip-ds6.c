@@ -93,6 +93,28 @@ static uip_ds6_nbr_t *locnbr;
 static uip_ds6_defrt_t *locdefrt;
 static uip_ds6_route_t *locroute;
 
+#if UIP_STATISTICS
+struct uip_ds6_nbr_stats uip_ds6_nbr_stats;
+#endif /* UIP_STATISTICS */
+
+uint8_t uip_ds6_nexthop_changed;
+
+/* Neighbors are stored at the first free slot following their home
+   slot. With UIP_DS6_NBR_HASH the home slot is a hash of the interface
+   identifier; otherwise it is always slot 0, which degenerates into the
+   plain linear scan. A search never needs to look further than the
+   longest displacement of any entry in the cache. */
+static uint8_t nbr_maxprobe;
+
+#if UIP_DS6_ROUTE_HASH
+/* Host routes are placed like neighbors, with a home slot hashed from
+   the whole address. Shorter prefixes take any free slot and are also
+   listed, longest first, in route_prefix[]. */
+static uint16_t route_maxprobe;
+static uint16_t route_prefix[UIP_DS6_ROUTE_NB];
+static uint16_t route_nprefixes;
+#endif /* UIP_DS6_ROUTE_HASH */
+
 /*---------------------------------------------------------------------------*/
 void
 uip_ds6_init(void)
@@ -106,6 +128,11 @@ uip_ds6_init(void)
   memset(uip_ds6_prefix_list, 0, sizeof(uip_ds6_prefix_list));
   memset(&uip_ds6_if, 0, sizeof(uip_ds6_if));
   memset(uip_ds6_routing_table, 0, sizeof(uip_ds6_routing_table));
+  nbr_maxprobe = 0;
+#if UIP_DS6_ROUTE_HASH
+  route_maxprobe = 0;
+  route_nprefixes = 0;
+#endif /* UIP_DS6_ROUTE_HASH */
 
   /* Set interface parameters */
   uip_ds6_if.link_mtu = UIP_LINK_MTU;
@@ -273,20 +300,97 @@ uip_ds6_list_loop(uip_ds6_element_t *list, uint8_t size,
   return *out_element != NULL ? FREESPACE : NOSPACE;
 }
 
+/*---------------------------------------------------------------------------*/
+static uint8_t
+nbr_home(uip_ipaddr_t *ipaddr)
+{
+#if UIP_DS6_NBR_HASH
+  uint16_t h;
+  uint8_t i;
+
+  h = 0;
+  for(i = 8; i < 16; i++) {
+    h = h * 31 + ipaddr->u8[i];
+  }
+  return h % (UIP_DS6_NBR_NB);
+#else /* UIP_DS6_NBR_HASH */
+  return 0;
+#endif /* UIP_DS6_NBR_HASH */
+}
+/*---------------------------------------------------------------------------*/
+/* Search the neighbor cache for ipaddr. Returns FOUND with locnbr set
+   to the entry, FREESPACE with locnbr set to the slot a new entry for
+   ipaddr should take, or NOSPACE. */
+static uint8_t
+nbr_search(uip_ipaddr_t *ipaddr)
+{
+  uint8_t home, i, n;
+  uip_ds6_nbr_t *nbr;
+
+  UIP_STAT(++uip_ds6_nbr_stats.lookups);
+  home = nbr_home(ipaddr);
+  locnbr = NULL;
+
+  for(n = 0, i = home; n < UIP_DS6_NBR_NB; n++) {
+    nbr = &uip_ds6_nbr_cache[i];
+    if(nbr->isused) {
+      if(n < nbr_maxprobe) {
+        UIP_STAT(++uip_ds6_nbr_stats.probes);
+        if(uip_ipaddr_cmp(&nbr->ipaddr, ipaddr)) {
+          locnbr = nbr;
+          return FOUND;
+        }
+      }
+    } else if(locnbr == NULL) {
+      locnbr = nbr;
+    }
+    if(n + 1 >= nbr_maxprobe && locnbr != NULL) {
+      /* Nothing can lie further from home. */
+      break;
+    }
+    if(++i == UIP_DS6_NBR_NB) {
+      i = 0;
+    }
+  }
+  return locnbr != NULL ? FREESPACE : NOSPACE;
+}
+/*---------------------------------------------------------------------------*/
+/* Recompute the longest displacement after an entry was removed. */
+static void
+nbr_update_maxprobe(void)
+{
+  uint8_t i, home, n;
+
+  nbr_maxprobe = 0;
+  for(i = 0; i < UIP_DS6_NBR_NB; i++) {
+    if(uip_ds6_nbr_cache[i].isused) {
+      home = nbr_home(&uip_ds6_nbr_cache[i].ipaddr);
+      n = (i >= home ? i - home : i + (UIP_DS6_NBR_NB) - home) + 1;
+      if(n > nbr_maxprobe) {
+        nbr_maxprobe = n;
+      }
+    }
+  }
+}
 /*---------------------------------------------------------------------------*/
 uip_ds6_nbr_t *
 uip_ds6_nbr_add(uip_ipaddr_t *ipaddr, uip_lladdr_t * lladdr,
                 uint8_t isrouter, uint8_t state)
 {
+  uint8_t home, n;
   int r;
 
-  r = uip_ds6_list_loop
-     ((uip_ds6_element_t *)uip_ds6_nbr_cache, UIP_DS6_NBR_NB,
-      sizeof(uip_ds6_nbr_t), ipaddr, 128,
-      (uip_ds6_element_t **)&locnbr);
+  r = nbr_search(ipaddr);
 
   if(r == FREESPACE) {
+    home = nbr_home(ipaddr);
+    n = locnbr - uip_ds6_nbr_cache;
+    n = (n >= home ? n - home : n + (UIP_DS6_NBR_NB) - home) + 1;
+    if(n > nbr_maxprobe) {
+      nbr_maxprobe = n;
+    }
     locnbr->isused = 1;
+    uip_ds6_nexthop_changed = 1;
     uip_ipaddr_copy(&locnbr->ipaddr, ipaddr);
     if(lladdr != NULL) {
       memcpy(&locnbr->lladdr, lladdr, UIP_LLADDR_LEN);
@@ -345,6 +449,8 @@ uip_ds6_nbr_rm(uip_ds6_nbr_t *nbr)
 {
   if(nbr != NULL) {
     nbr->isused = 0;
+    nbr_update_maxprobe();
+    uip_ds6_nexthop_changed = 1;
 #if UIP_CONF_IPV6_QUEUE_PKT
     uip_packetqueue_free(&nbr->packethandle);
 #endif /* UIP_CONF_IPV6_QUEUE_PKT */
@@ -357,10 +463,7 @@ uip_ds6_nbr_rm(uip_ds6_nbr_t *nbr)
 uip_ds6_nbr_t *
 uip_ds6_nbr_lookup(uip_ipaddr_t *ipaddr)
 {
-  if(uip_ds6_list_loop
-     ((uip_ds6_element_t *)uip_ds6_nbr_cache, UIP_DS6_NBR_NB,
-      sizeof(uip_ds6_nbr_t), ipaddr, 128,
-      (uip_ds6_element_t **)&locnbr) == FOUND) {
+  if(nbr_search(ipaddr) == FOUND) {
     return locnbr;
   }
   return NULL;
@@ -375,6 +478,7 @@ uip_ds6_defrt_add(uip_ipaddr_t *ipaddr, unsigned long interval)
       sizeof(uip_ds6_defrt_t), ipaddr, 128,
       (uip_ds6_element_t **)&locdefrt) == FREESPACE) {
     locdefrt->isused = 1;
+    uip_ds6_nexthop_changed = 1;
     uip_ipaddr_copy(&locdefrt->ipaddr, ipaddr);
     if(interval != 0) {
       stimer_set(&locdefrt->lifetime, interval);
@@ -400,6 +504,7 @@ uip_ds6_defrt_rm(uip_ds6_defrt_t *defrt)
 {
   if(defrt != NULL) {
     defrt->isused = 0;
+    uip_ds6_nexthop_changed = 1;
     ANNOTATE("#L %u 0\n", defrt->ipaddr.u8[sizeof(uip_ipaddr_t) - 1]);
   }
   return;
@@ -459,6 +564,7 @@ uip_ds6_prefix_add(uip_ipaddr_t *ipaddr, uint8_t ipaddrlen,
       sizeof(uip_ds6_prefix_t), ipaddr, ipaddrlen,
       (uip_ds6_element_t **)&locprefix) == FREESPACE) {
     locprefix->isused = 1;
+    uip_ds6_nexthop_changed = 1;
     uip_ipaddr_copy(&locprefix->ipaddr, ipaddr);
     locprefix->length = ipaddrlen;
     locprefix->advertise = advertise;
@@ -487,6 +593,7 @@ uip_ds6_prefix_add(uip_ipaddr_t *ipaddr, uint8_t ipaddrlen,
       sizeof(uip_ds6_prefix_t), ipaddr, ipaddrlen,
       (uip_ds6_element_t **)&locprefix) == FREESPACE) {
     locprefix->isused = 1;
+    uip_ds6_nexthop_changed = 1;
     uip_ipaddr_copy(&locprefix->ipaddr, ipaddr);
     locprefix->length = ipaddrlen;
     if(interval != 0) {
@@ -509,6 +616,7 @@ uip_ds6_prefix_rm(uip_ds6_prefix_t * prefix)
 {
   if(prefix != NULL) {
     prefix->isused = 0;
+    uip_ds6_nexthop_changed = 1;
   }
   return;
 }
@@ -709,17 +817,173 @@ uip_ds6_aaddr_lookup(uip_ipaddr_t *ipaddr)
   return NULL;
 }
 
+#if UIP_DS6_ROUTE_HASH
+/*---------------------------------------------------------------------------*/
+static uint16_t
+route_home(uip_ipaddr_t *ipaddr)
+{
+  uint16_t h;
+  uint8_t i;
+
+  h = 0;
+  for(i = 0; i < 16; i++) {
+    h = h * 31 + ipaddr->u8[i];
+  }
+  return h % (UIP_DS6_ROUTE_NB);
+}
+/*---------------------------------------------------------------------------*/
+static uint16_t
+route_displacement(uip_ds6_route_t *route)
+{
+  uint16_t i, home;
+
+  i = route - uip_ds6_routing_table;
+  home = route_home(&route->ipaddr);
+  return (i >= home ? i - home : i + (UIP_DS6_ROUTE_NB) - home) + 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Search the host routes for ipaddr. Returns FOUND with locroute set to
+   the route, FREESPACE with locroute set to the slot a new host route
+   for ipaddr should take, or NOSPACE. */
+static uint8_t
+route_search_host(uip_ipaddr_t *ipaddr)
+{
+  uint16_t i, n;
+  uip_ds6_route_t *r;
+
+  locroute = NULL;
+  for(n = 0, i = route_home(ipaddr); n < UIP_DS6_ROUTE_NB; n++) {
+    r = &uip_ds6_routing_table[i];
+    if(r->isused) {
+      if(n < route_maxprobe && r->length == 128 &&
+         uip_ipaddr_cmp(&r->ipaddr, ipaddr)) {
+        locroute = r;
+        return FOUND;
+      }
+    } else if(locroute == NULL) {
+      locroute = r;
+    }
+    if(n + 1 >= route_maxprobe && locroute != NULL) {
+      break;
+    }
+    if(++i == UIP_DS6_ROUTE_NB) {
+      i = 0;
+    }
+  }
+  return locroute != NULL ? FREESPACE : NOSPACE;
+}
+/*---------------------------------------------------------------------------*/
+/* Search the prefix routes for an exact match. Returns FOUND with
+   locroute set to the route, FREESPACE with locroute set to a free
+   slot, or NOSPACE. */
+static uint8_t
+route_search_prefix(uip_ipaddr_t *ipaddr, uint8_t length)
+{
+  uint16_t i;
+
+  for(i = 0; i < route_nprefixes; i++) {
+    locroute = &uip_ds6_routing_table[route_prefix[i]];
+    if(locroute->length == length &&
+       uip_ipaddr_prefixcmp(&locroute->ipaddr, ipaddr, length)) {
+      return FOUND;
+    }
+  }
+  /* Take free slots from the top, away from most home slots. */
+  for(i = UIP_DS6_ROUTE_NB; i > 0; i--) {
+    locroute = &uip_ds6_routing_table[i - 1];
+    if(!locroute->isused) {
+      return FREESPACE;
+    }
+  }
+  locroute = NULL;
+  return NOSPACE;
+}
+/*---------------------------------------------------------------------------*/
+static void
+route_link(uip_ds6_route_t *route)
+{
+  uint16_t i, n;
+
+  if(route->length == 128) {
+    n = route_displacement(route);
+    if(n > route_maxprobe) {
+      route_maxprobe = n;
+    }
+  } else {
+    /* Insert after all the routes that are at least as long. */
+    for(i = route_nprefixes; i > 0 &&
+          uip_ds6_routing_table[route_prefix[i - 1]].length < route->length;
+        i--) {
+      route_prefix[i] = route_prefix[i - 1];
+    }
+    route_prefix[i] = route - uip_ds6_routing_table;
+    route_nprefixes++;
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+route_unlink(uip_ds6_route_t *route)
+{
+  uint16_t i, n;
+
+  route->isused = 0;
+  uip_ds6_nexthop_changed = 1;
+  if(route->length == 128) {
+    if(route_displacement(route) == route_maxprobe) {
+      route_maxprobe = 0;
+      for(i = 0; i < UIP_DS6_ROUTE_NB; i++) {
+        if(uip_ds6_routing_table[i].isused &&
+           uip_ds6_routing_table[i].length == 128) {
+          n = route_displacement(&uip_ds6_routing_table[i]);
+          if(n > route_maxprobe) {
+            route_maxprobe = n;
+          }
+        }
+      }
+    }
+  } else {
+    n = route - uip_ds6_routing_table;
+    for(i = 0; i < route_nprefixes && route_prefix[i] != n; i++);
+    if(i < route_nprefixes) {
+      route_nprefixes--;
+      for(; i < route_nprefixes; i++) {
+        route_prefix[i] = route_prefix[i + 1];
+      }
+    }
+  }
+}
+#else /* UIP_DS6_ROUTE_HASH */
+#define route_unlink(route) ((route)->isused = 0, uip_ds6_nexthop_changed = 1)
+#endif /* UIP_DS6_ROUTE_HASH */
 /*---------------------------------------------------------------------------*/
 uip_ds6_route_t *
 uip_ds6_route_lookup(uip_ipaddr_t *destipaddr)
 {
   uip_ds6_route_t *locrt = NULL;
+#if UIP_DS6_ROUTE_HASH
+  uint16_t i;
+#else /* UIP_DS6_ROUTE_HASH */
   uint8_t longestmatch = 0;
+#endif /* UIP_DS6_ROUTE_HASH */
 
   PRINTF("DS6: Looking up route for ");
   PRINT6ADDR(destipaddr);
   PRINTF("\n");
 
+#if UIP_DS6_ROUTE_HASH
+  if(route_maxprobe > 0 && route_search_host(destipaddr) == FOUND) {
+    locrt = locroute;
+  } else {
+    for(i = 0; i < route_nprefixes; i++) {
+      locroute = &uip_ds6_routing_table[route_prefix[i]];
+      if(uip_ipaddr_prefixcmp(destipaddr, &locroute->ipaddr,
+                              locroute->length)) {
+        locrt = locroute;
+        break;
+      }
+    }
+  }
+#else /* UIP_DS6_ROUTE_HASH */
   for(locroute = uip_ds6_routing_table;
       locroute < uip_ds6_routing_table + UIP_DS6_ROUTE_NB; locroute++) {
     if((locroute->isused) && (locroute->length >= longestmatch)
@@ -730,6 +994,7 @@ uip_ds6_route_lookup(uip_ipaddr_t *destipaddr)
       locrt = locroute;
     }
   }
+#endif /* UIP_DS6_ROUTE_HASH */
 
   if(locrt != NULL) {
     PRINTF("DS6: Found route:");
@@ -749,15 +1014,31 @@ uip_ds6_route_t *
 uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length, uip_ipaddr_t *nexthop,
                   uint8_t metric)
 {
-  if(uip_ds6_list_loop
+  uint8_t r;
+
+#if UIP_DS6_ROUTE_HASH
+  if(length == 128) {
+    r = route_search_host(ipaddr);
+  } else {
+    r = route_search_prefix(ipaddr, length);
+  }
+#else /* UIP_DS6_ROUTE_HASH */
+  r = uip_ds6_list_loop
      ((uip_ds6_element_t *)uip_ds6_routing_table, UIP_DS6_ROUTE_NB,
       sizeof(uip_ds6_route_t), ipaddr, length,
-      (uip_ds6_element_t **)&locroute) == FREESPACE) {
+      (uip_ds6_element_t **)&locroute);
+#endif /* UIP_DS6_ROUTE_HASH */
+
+  if(r == FREESPACE) {
     locroute->isused = 1;
+    uip_ds6_nexthop_changed = 1;
     uip_ipaddr_copy(&(locroute->ipaddr), ipaddr);
     locroute->length = length;
     uip_ipaddr_copy(&(locroute->nexthop), nexthop);
     locroute->metric = metric;
+#if UIP_DS6_ROUTE_HASH
+    route_link(locroute);
+#endif /* UIP_DS6_ROUTE_HASH */
 
     PRINTF("DS6: adding route: ");
     PRINT6ADDR(ipaddr);
@@ -774,7 +1055,7 @@ uip_ds6_route_add(uip_ipaddr_t *ipaddr, uint8_t length, uip_ipaddr_t *nexthop,
 void
 uip_ds6_route_rm(uip_ds6_route_t *route)
 {
-  route->isused = 0;
+  route_unlink(route);
 #if (DEBUG & DEBUG_ANNOTATE) == DEBUG_ANNOTATE
   /* we need to check if this was the last route towards "nexthop" */
   /* if so - remove that link (annotation) */
@@ -797,7 +1078,7 @@ uip_ds6_route_rm_by_nexthop(uip_ipaddr_t *nexthop)
       locroute < uip_ds6_routing_table + UIP_DS6_ROUTE_NB;
       locroute++) {
     if(locroute->isused && uip_ipaddr_cmp(&locroute->nexthop, nexthop)) {
-      locroute->isused = 0;
+      route_unlink(locroute);
     }
   }
   ANNOTATE("#L %u 0\n",nexthop->u8[sizeof(uip_ipaddr_t) - 1]);
@@ -62,6 +62,14 @@
 #endif
 #define UIP_DS6_NBR_NB UIP_DS6_NBR_NBS + UIP_DS6_NBR_NBU
 
+/* Place neighbors by a hash of the interface identifier (open
+   addressing) instead of scanning the whole cache on every lookup */
+#ifndef UIP_CONF_DS6_NBR_HASH
+#define UIP_DS6_NBR_HASH 0
+#else
+#define UIP_DS6_NBR_HASH UIP_CONF_DS6_NBR_HASH
+#endif
+
 /* Default router list */
 #define UIP_DS6_DEFRT_NBS 0
 #ifndef UIP_CONF_DS6_DEFRT_NBU
@@ -89,6 +97,15 @@
 #endif
 #define UIP_DS6_ROUTE_NB UIP_DS6_ROUTE_NBS + UIP_DS6_ROUTE_NBU
 
+/* Hash host (/128) routes on their address and keep the other routes in
+   a list sorted by prefix length, so that forwarding does not have to
+   compare the destination against every route */
+#ifndef UIP_CONF_DS6_ROUTE_HASH
+#define UIP_DS6_ROUTE_HASH 0
+#else
+#define UIP_DS6_ROUTE_HASH UIP_CONF_DS6_ROUTE_HASH
+#endif
+
 /* Unicast address list*/
 #define UIP_DS6_ADDR_NBS 1
 #ifndef UIP_CONF_DS6_ADDR_NBU
@@ -283,6 +300,13 @@ typedef struct uip_ds6_element {
 extern uip_ds6_netif_t uip_ds6_if;
 extern struct etimer uip_ds6_timer_periodic;
 
+/** \brief Set when a neighbor, route, default router or prefix is added
+ * or removed, when the next hop of a route is changed in place, or when
+ * a neighbor leaves the INCOMPLETE state, which can change the choice
+ * of uip_ds6_defrt_choose(). Users that cache next hop decisions clear
+ * it after flushing. */
+extern uint8_t uip_ds6_nexthop_changed;
+
 #if UIP_CONF_ROUTER
 extern uip_ds6_prefix_t uip_ds6_prefix_list[UIP_DS6_PREFIX_NB];
 #else /* UIP_CONF_ROUTER */
@@ -311,6 +335,16 @@ uip_ds6_nbr_t *uip_ds6_nbr_add(uip_ipaddr_t *ipaddr, uip_lladdr_t *lladdr,
 void uip_ds6_nbr_rm(uip_ds6_nbr_t *nbr);
 uip_ds6_nbr_t *uip_ds6_nbr_lookup(uip_ipaddr_t *ipaddr);
 
+#if UIP_STATISTICS
+/** \brief Cost of the neighbor cache searches */
+struct uip_ds6_nbr_stats {
+  uip_stats_t lookups;          /**< Number of searches. */
+  uip_stats_t probes;           /**< Number of entries compared. */
+};
+
+extern struct uip_ds6_nbr_stats uip_ds6_nbr_stats;
+#endif /* UIP_STATISTICS */
+
 /** @} */
 
 /** \name Default router list basic routines */
@@ -205,9 +205,11 @@ uip_nd6_ns_input(void)
             memcpy(&nbr->lladdr, &nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET],
 		   UIP_LLADDR_LEN);
             nbr->state = NBR_STALE;
+            uip_ds6_nexthop_changed = 1;
           } else {
             if(nbr->state == NBR_INCOMPLETE) {
               nbr->state = NBR_STALE;
+              uip_ds6_nexthop_changed = 1;
             }
           }
         }
@@ -473,6 +475,9 @@ uip_nd6_na_input(void)
         nbr->state = NBR_STALE;
       }
       nbr->isrouter = is_router;
+      /* A default router that resolves may now be preferred by
+         uip_ds6_defrt_choose() */
+      uip_ds6_nexthop_changed = 1;
     } else {
       if(!is_override && is_llchange) {
         if(nbr->state == NBR_REACHABLE) {
@@ -514,10 +519,8 @@ uip_nd6_na_input(void)
     nbr->queue_buf_len = 0;
     return;
     }*/
-  if(uip_packetqueue_buflen(&nbr->packethandle) != 0) {
-    uip_len = uip_packetqueue_buflen(&nbr->packethandle);
-    memcpy(UIP_IP_BUF, uip_packetqueue_buf(&nbr->packethandle), uip_len);
-    uip_packetqueue_free(&nbr->packethandle);
+  /* tcpip_ipv6_output() sends the older packets before this one */
+  if(uip_packetqueue_pull_newest(&nbr->packethandle)) {
     return;
   }
   
@@ -597,6 +600,7 @@ uip_nd6_rs_input(void)
           memcpy(&nbr->lladdr, &nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET],
 		 UIP_LLADDR_LEN);
           nbr->state = NBR_STALE;
+          uip_ds6_nexthop_changed = 1;
         }
         nbr->isrouter = 0;
       }
@@ -796,12 +800,14 @@ uip_nd6_ra_input(void)
       } else {
         if(nbr->state == NBR_INCOMPLETE) {
           nbr->state = NBR_STALE;
+          uip_ds6_nexthop_changed = 1;
         }
         if(memcmp(&nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET],
 		  &nbr->lladdr, UIP_LLADDR_LEN) != 0) {
           memcpy(&nbr->lladdr, &nd6_opt_llao[UIP_ND6_OPT_DATA_OFFSET],
 		 UIP_LLADDR_LEN);
           nbr->state = NBR_STALE;
+          uip_ds6_nexthop_changed = 1;
         }
         nbr->isrouter = 1;
       }
@@ -932,10 +938,7 @@ uip_nd6_ra_input(void)
     nbr->queue_buf_len = 0;
     return;
     }*/
-  if(nbr != NULL && uip_packetqueue_buflen(&nbr->packethandle) != 0) {
-    uip_len = uip_packetqueue_buflen(&nbr->packethandle);
-    memcpy(UIP_IP_BUF, uip_packetqueue_buf(&nbr->packethandle), uip_len);
-    uip_packetqueue_free(&nbr->packethandle);
+  if(nbr != NULL && uip_packetqueue_pull_newest(&nbr->packethandle)) {
     return;
   }
 
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 
 #include "net/uip.h"
 
@@ -6,8 +7,11 @@
 
 #include "net/uip-packetqueue.h"
 
-#define MAX_NUM_QUEUED_PACKETS 2
-MEMB(packets_memb, struct uip_packetqueue_packet, MAX_NUM_QUEUED_PACKETS);
+MEMB(packets_memb, struct uip_packetqueue_packet, UIP_PACKETQUEUE_SIZE);
+
+#if UIP_STATISTICS
+struct uip_packetqueue_stats uip_packetqueue_stats;
+#endif /* UIP_STATISTICS */
 
 #define DEBUG 0
 #if DEBUG
@@ -17,15 +21,44 @@ MEMB(packets_memb, struct uip_packetqueue_packet, MAX_NUM_QUEUED_PACKETS);
 #define PRINTF(...)
 #endif
 
+/*---------------------------------------------------------------------------*/
+static void
+packet_remove(struct uip_packetqueue_packet *p)
+{
+  struct uip_packetqueue_handle *h = p->handle;
+  struct uip_packetqueue_packet **pp;
+
+  for(pp = &h->packet; *pp != NULL; pp = &(*pp)->next) {
+    if(*pp == p) {
+      *pp = p->next;
+      h->len--;
+      break;
+    }
+  }
+  ctimer_stop(&p->lifetimer);
+#if UIP_BUFFER_POOL
+  uip_pbuf_free(p->pbuf);
+#endif /* UIP_BUFFER_POOL */
+  memb_free(&packets_memb, p);
+}
 /*---------------------------------------------------------------------------*/
 static void
 packet_timedout(void *ptr)
 {
-  struct uip_packetqueue_handle *h = ptr;
+  struct uip_packetqueue_packet *p = ptr;
 
-  PRINTF("uip_packetqueue_free timed out %p\n", h);
-  memb_free(&packets_memb, h->packet);
-  h->packet = NULL;
+  PRINTF("uip_packetqueue_free timed out %p\n", p->handle);
+  UIP_STAT(++uip_packetqueue_stats.expired);
+  packet_remove(p);
+}
+/*---------------------------------------------------------------------------*/
+static struct uip_packetqueue_packet *
+tail(struct uip_packetqueue_handle *h)
+{
+  struct uip_packetqueue_packet *p;
+
+  for(p = h->packet; p != NULL && p->next != NULL; p = p->next);
+  return p;
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -33,54 +66,201 @@ uip_packetqueue_new(struct uip_packetqueue_handle *handle)
 {
   PRINTF("uip_packetqueue_new %p\n", handle);
   handle->packet = NULL;
+  handle->len = 0;
 }
 /*---------------------------------------------------------------------------*/
 struct uip_packetqueue_packet *
 uip_packetqueue_alloc(struct uip_packetqueue_handle *handle, clock_time_t lifetime)
 {
+  struct uip_packetqueue_packet *p, *last;
+
   PRINTF("uip_packetqueue_alloc %p\n", handle);
-  if(handle->packet != NULL) {
-    PRINTF("alloced\n");
+  if(handle->len >= UIP_PACKETQUEUE_DEPTH) {
+    PRINTF("full, dropping oldest\n");
+    UIP_STAT(++uip_packetqueue_stats.overflow);
+    uip_packetqueue_pop(handle);
+  }
+  p = memb_alloc(&packets_memb);
+  if(p == NULL && handle->packet != NULL) {
+    PRINTF("no buffer, dropping oldest\n");
+    UIP_STAT(++uip_packetqueue_stats.overflow);
+    uip_packetqueue_pop(handle);
+    p = memb_alloc(&packets_memb);
+  }
+  if(p == NULL) {
+    PRINTF("uip_packetqueue_alloc failed\n");
+    UIP_STAT(++uip_packetqueue_stats.nomem);
     return NULL;
   }
-  handle->packet = memb_alloc(&packets_memb);
-  if(handle->packet != NULL) {
-    ctimer_set(&handle->packet->lifetimer, lifetime,
-               packet_timedout, handle);
+
+  p->next = NULL;
+#if UIP_BUFFER_POOL
+  p->pbuf = NULL;
+#else /* UIP_BUFFER_POOL */
+  p->queue_buf_len = 0;
+#endif /* UIP_BUFFER_POOL */
+  p->handle = handle;
+  last = tail(handle);
+  if(last == NULL) {
+    handle->packet = p;
   } else {
-    PRINTF("uip_packetqueue_alloc failed\n");
+    last->next = p;
+  }
+  handle->len++;
+  ctimer_set(&p->lifetimer, lifetime, packet_timedout, p);
+  return p;
+}
+/*---------------------------------------------------------------------------*/
+int
+uip_packetqueue_push(struct uip_packetqueue_handle *handle, clock_time_t lifetime)
+{
+  struct uip_packetqueue_packet *p;
+
+  p = uip_packetqueue_alloc(handle, lifetime);
+  if(p == NULL) {
+    return 0;
+  }
+#if UIP_BUFFER_POOL
+  p->pbuf = uip_pbuf_detach();
+  if(p->pbuf == NULL && handle->packet != p) {
+    PRINTF("no uip buffer, dropping oldest\n");
+    UIP_STAT(++uip_packetqueue_stats.overflow);
+    uip_packetqueue_pop(handle);
+    p->pbuf = uip_pbuf_detach();
+  }
+  if(p->pbuf == NULL) {
+    PRINTF("uip_packetqueue_push failed\n");
+    UIP_STAT(++uip_packetqueue_stats.nomem);
+    packet_remove(p);
+    return 0;
   }
-  return handle->packet;
+#else /* UIP_BUFFER_POOL */
+  memcpy(p->queue_buf, &uip_buf[UIP_LLH_LEN], uip_len);
+  p->queue_buf_len = uip_len;
+#endif /* UIP_BUFFER_POOL */
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+packet_pull(struct uip_packetqueue_packet *p)
+{
+  if(p == NULL) {
+    return 0;
+  }
+#if UIP_BUFFER_POOL
+  uip_pbuf_attach(p->pbuf);
+  p->pbuf = NULL;
+#else /* UIP_BUFFER_POOL */
+  uip_len = p->queue_buf_len;
+  memcpy(&uip_buf[UIP_LLH_LEN], p->queue_buf, uip_len);
+#endif /* UIP_BUFFER_POOL */
+  packet_remove(p);
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+int
+uip_packetqueue_pull(struct uip_packetqueue_handle *handle)
+{
+  return packet_pull(handle->packet);
+}
+/*---------------------------------------------------------------------------*/
+int
+uip_packetqueue_pull_newest(struct uip_packetqueue_handle *handle)
+{
+  return packet_pull(tail(handle));
+}
+/*---------------------------------------------------------------------------*/
+int
+uip_packetqueue_swap(struct uip_packetqueue_handle *handle)
+{
+  struct uip_packetqueue_packet *p = handle->packet;
+  struct uip_packetqueue_packet *last;
+#if !UIP_BUFFER_POOL
+  uint16_t i, len;
+  uint8_t tmp;
+#endif /* !UIP_BUFFER_POOL */
+
+  if(p == NULL) {
+    return 0;
+  }
+#if UIP_BUFFER_POOL
+  p->pbuf = uip_pbuf_exchange(p->pbuf);
+#else /* UIP_BUFFER_POOL */
+  /* Swap in place, there is no room for a third copy */
+  len = uip_len > p->queue_buf_len? uip_len: p->queue_buf_len;
+  for(i = 0; i < len; i++) {
+    tmp = uip_buf[UIP_LLH_LEN + i];
+    uip_buf[UIP_LLH_LEN + i] = p->queue_buf[i];
+    p->queue_buf[i] = tmp;
+  }
+  len = uip_len;
+  uip_len = p->queue_buf_len;
+  p->queue_buf_len = len;
+#endif /* UIP_BUFFER_POOL */
+
+  /* Move the packet to the tail */
+  last = tail(handle);
+  if(last != p) {
+    handle->packet = p->next;
+    p->next = NULL;
+    last->next = p;
+  }
+  return 1;
 }
 /*---------------------------------------------------------------------------*/
 void
 uip_packetqueue_free(struct uip_packetqueue_handle *handle)
 {
   PRINTF("uip_packetqueue_free %p\n", handle);
+  while(handle->packet != NULL) {
+    packet_remove(handle->packet);
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_packetqueue_pop(struct uip_packetqueue_handle *handle)
+{
   if(handle->packet != NULL) {
-    ctimer_stop(&handle->packet->lifetimer);
-    memb_free(&packets_memb, handle->packet);
-    handle->packet = NULL;
+    packet_remove(handle->packet);
   }
 }
 /*---------------------------------------------------------------------------*/
 uint8_t *
 uip_packetqueue_buf(struct uip_packetqueue_handle *h)
 {
+#if UIP_BUFFER_POOL
+  return h->packet != NULL && h->packet->pbuf != NULL?
+    &h->packet->pbuf->buf.u8[UIP_LLH_LEN]: NULL;
+#else /* UIP_BUFFER_POOL */
   return h->packet != NULL? h->packet->queue_buf: NULL;
+#endif /* UIP_BUFFER_POOL */
 }
 /*---------------------------------------------------------------------------*/
 uint16_t
 uip_packetqueue_buflen(struct uip_packetqueue_handle *h)
 {
+#if UIP_BUFFER_POOL
+  return h->packet != NULL && h->packet->pbuf != NULL?
+    h->packet->pbuf->len: 0;
+#else /* UIP_BUFFER_POOL */
   return h->packet != NULL? h->packet->queue_buf_len: 0;
+#endif /* UIP_BUFFER_POOL */
 }
 /*---------------------------------------------------------------------------*/
 void
 uip_packetqueue_set_buflen(struct uip_packetqueue_handle *h, uint16_t len)
 {
-  if(h->packet != NULL) {
-    h->packet->queue_buf_len = len;
+  struct uip_packetqueue_packet *p;
+
+  p = tail(h);
+#if UIP_BUFFER_POOL
+  if(p != NULL && p->pbuf != NULL) {
+    p->pbuf->len = len;
+  }
+#else /* UIP_BUFFER_POOL */
+  if(p != NULL) {
+    p->queue_buf_len = len;
   }
+#endif /* UIP_BUFFER_POOL */
 }
 /*---------------------------------------------------------------------------*/
@@ -3,32 +3,98 @@
 
 #include "sys/ctimer.h"
 
+/* Number of packet buffers shared by all queues */
+#ifdef UIP_CONF_PACKETQUEUE_SIZE
+#define UIP_PACKETQUEUE_SIZE UIP_CONF_PACKETQUEUE_SIZE
+#else
+#define UIP_PACKETQUEUE_SIZE 2
+#endif
+
+/* Maximum number of packets held by one queue. When a queue is full,
+   or the shared pool is empty, the oldest packet of the queue is
+   dropped to make room for the new one. The default of one keeps a
+   single packet per neighbor, as before queues could grow, so that
+   one unreachable neighbor cannot take the whole pool. */
+#ifdef UIP_CONF_PACKETQUEUE_DEPTH
+#define UIP_PACKETQUEUE_DEPTH UIP_CONF_PACKETQUEUE_DEPTH
+#else
+#define UIP_PACKETQUEUE_DEPTH 1
+#endif
+
 struct uip_packetqueue_handle;
 
 struct uip_packetqueue_packet {
-  struct uip_ds6_queued_packet *next;
+  struct uip_packetqueue_packet *next;
+#if UIP_BUFFER_POOL
+  /* The packet keeps the uIP buffer it was sent from */
+  struct uip_pbuf *pbuf;
+#else /* UIP_BUFFER_POOL */
   uint8_t queue_buf[UIP_BUFSIZE - UIP_LLH_LEN];
   uint16_t queue_buf_len;
+#endif /* UIP_BUFFER_POOL */
   struct ctimer lifetimer;
   struct uip_packetqueue_handle *handle;
 };
 
+/* A FIFO of packets, oldest first */
 struct uip_packetqueue_handle {
   struct uip_packetqueue_packet *packet;
+  uint8_t len;
 };
 
-void uip_packetqueue_new(struct uip_packetqueue_handle *handle);
+#if UIP_STATISTICS
+struct uip_packetqueue_stats {
+  uip_stats_t overflow;         /**< Oldest packet dropped for a new one. */
+  uip_stats_t nomem;            /**< Packet dropped, no buffer at all. */
+  uip_stats_t expired;          /**< Packet dropped when its lifetime
+                                   ran out. */
+};
+
+extern struct uip_packetqueue_stats uip_packetqueue_stats;
+#endif /* UIP_STATISTICS */
 
+void uip_packetqueue_new(struct uip_packetqueue_handle *handle);
 
+/* Append a packet to the queue and return it; the caller fills in
+   queue_buf and queue_buf_len (or pbuf with a uIP buffer pool) */
 struct uip_packetqueue_packet *
 uip_packetqueue_alloc(struct uip_packetqueue_handle *handle, clock_time_t lifetime);
 
+/* Append the packet in uip_buf to the queue. With a uIP buffer pool
+   the packet keeps its buffer and uip_buf is replaced by an empty
+   one, otherwise the packet is copied. Returns 0 if it was dropped. */
+int
+uip_packetqueue_push(struct uip_packetqueue_handle *handle, clock_time_t lifetime);
 
+/* Move the oldest packet of the queue into uip_buf and uip_len.
+   Returns 0 if the queue was empty. */
+int
+uip_packetqueue_pull(struct uip_packetqueue_handle *handle);
+
+/* Move the newest packet of the queue into uip_buf and uip_len.
+   Returns 0 if the queue was empty. */
+int
+uip_packetqueue_pull_newest(struct uip_packetqueue_handle *handle);
+
+/* Exchange the packet in uip_buf with the oldest packet of the
+   queue, which then goes to the tail of the queue. Unlike a push, it
+   never drops a packet. Returns 0 if the queue was empty. */
+int
+uip_packetqueue_swap(struct uip_packetqueue_handle *handle);
+
+/* Drop all packets of the queue */
 void
 uip_packetqueue_free(struct uip_packetqueue_handle *handle);
 
+/* Drop the oldest packet of the queue */
+void
+uip_packetqueue_pop(struct uip_packetqueue_handle *handle);
+
+/* The oldest packet of the queue */
 uint8_t *uip_packetqueue_buf(struct uip_packetqueue_handle *h);
 uint16_t uip_packetqueue_buflen(struct uip_packetqueue_handle *h);
+
+/* Set the length of the newest packet of the queue */
 void uip_packetqueue_set_buflen(struct uip_packetqueue_handle *h, uint16_t len);
 
 
@@ -0,0 +1,145 @@
+#include <string.h>
+
+#include "net/uip.h"
+
+#if UIP_TCP && UIP_TCP_SNDWND
+
+#include "lib/memb.h"
+
+#include "net/uip-sndwnd.h"
+
+MEMB(segs_memb, struct uip_sndwnd_seg, UIP_TCP_SNDWND);
+
+/* Number of segments in use, to tell if the pool is empty without
+   allocating */
+static u8_t segs_used;
+
+/*---------------------------------------------------------------------------*/
+static u32_t
+seq32(const u8_t *seq)
+{
+  return ((u32_t)seq[0] << 24) | ((u32_t)seq[1] << 16) |
+    ((u32_t)seq[2] << 8) | seq[3];
+}
+/*---------------------------------------------------------------------------*/
+static void
+seg_free(struct uip_sndwnd_seg *seg)
+{
+  memb_free(&segs_memb, seg);
+  segs_used--;
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_sndwnd_init(void)
+{
+  memb_init(&segs_memb);
+  segs_used = 0;
+}
+/*---------------------------------------------------------------------------*/
+u16_t
+uip_sndwnd_room(struct uip_conn *conn)
+{
+  u16_t wnd;
+
+  if(conn->sndwnd != UIP_SNDWND_ON || segs_used == UIP_TCP_SNDWND) {
+    return 0;
+  }
+
+  /* As without a send window, one segment may be sent into a zero
+     window; it is retransmitted until the window opens. */
+  wnd = conn->snd_wnd;
+  if(wnd == 0 && conn->len == 0) {
+    wnd = conn->initialmss;
+  }
+  if(wnd <= conn->len) {
+    return 0;
+  }
+  wnd -= conn->len;
+  return wnd < conn->initialmss ? wnd : conn->initialmss;
+}
+/*---------------------------------------------------------------------------*/
+int
+uip_sndwnd_push(struct uip_conn *conn, const void *data, u16_t len)
+{
+  struct uip_sndwnd_seg *seg, **sp;
+
+  seg = memb_alloc(&segs_memb);
+  if(seg == NULL) {
+    return 0;
+  }
+  segs_used++;
+
+  seg->next = NULL;
+  seg->len = len;
+  seg->timed = conn->sndq == NULL;
+  memcpy(seg->data, data, len);
+
+  for(sp = &conn->sndq; *sp != NULL; sp = &(*sp)->next);
+  *sp = seg;
+  conn->len += len;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+u16_t
+uip_sndwnd_ack(struct uip_conn *conn, const u8_t *ackno, u8_t *timed)
+{
+  struct uip_sndwnd_seg *seg;
+  u32_t acked, seq;
+  u16_t n;
+
+  *timed = 0;
+  seq = seq32(conn->snd_nxt);
+  acked = seq32(ackno) - seq;
+  if(acked == 0 || acked > conn->len) {
+    return 0;
+  }
+
+  seq += acked;
+  conn->snd_nxt[0] = seq >> 24;
+  conn->snd_nxt[1] = seq >> 16;
+  conn->snd_nxt[2] = seq >> 8;
+  conn->snd_nxt[3] = seq;
+  conn->len -= acked;
+
+  for(n = acked; n > 0;) {
+    seg = conn->sndq;
+    if(seg->len <= n) {
+      n -= seg->len;
+      *timed |= seg->timed;
+      conn->sndq = seg->next;
+      seg_free(seg);
+    } else {
+      /* The peer acknowledged part of a segment; keep the rest */
+      seg->len -= n;
+      memmove(seg->data, &seg->data[n], seg->len);
+      n = 0;
+    }
+  }
+  return acked;
+}
+/*---------------------------------------------------------------------------*/
+u16_t
+uip_sndwnd_oldest(struct uip_conn *conn, void *buf)
+{
+  struct uip_sndwnd_seg *seg = conn->sndq;
+
+  /* A retransmission does not give a valid RTT */
+  seg->timed = 0;
+  memcpy(buf, seg->data, seg->len);
+  return seg->len;
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_sndwnd_flush(struct uip_conn *conn)
+{
+  struct uip_sndwnd_seg *seg;
+
+  while(conn->sndq != NULL) {
+    seg = conn->sndq;
+    conn->sndq = seg->next;
+    seg_free(seg);
+  }
+  conn->dupacks = 0;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* UIP_TCP && UIP_TCP_SNDWND */
@@ -0,0 +1,39 @@
+#ifndef UIP_SNDWND_H
+#define UIP_SNDWND_H
+
+#include "net/uip.h"
+
+/* Number of duplicate ACKs after which the oldest unacknowledged
+   segment is sent again without waiting for the retransmission
+   timer (fast retransmit) */
+#define UIP_SNDWND_DUPACKS 3
+
+/* A segment that has been sent but not yet acknowledged */
+struct uip_sndwnd_seg {
+  struct uip_sndwnd_seg *next;
+  u16_t len;
+  /* The RTT is measured on this segment: it was sent when nothing
+     else was in flight */
+  u8_t timed;
+  u8_t data[UIP_TCP_MSS];
+};
+
+void uip_sndwnd_init(void);
+
+/* Keep a copy of len bytes of data that are sent on conn after the
+   data already in flight. Returns 0 if all segments are in use. */
+int uip_sndwnd_push(struct uip_conn *conn, const void *data, u16_t len);
+
+/* Drop the data acknowledged by ackno and advance the sequence number
+   of conn past it. Returns the number of bytes newly acknowledged, 0
+   if ackno acknowledges nothing new. *timed is set if the RTT of the
+   acknowledged data may be measured. */
+u16_t uip_sndwnd_ack(struct uip_conn *conn, const u8_t *ackno, u8_t *timed);
+
+/* Copy the oldest unacknowledged segment to buf, return its length */
+u16_t uip_sndwnd_oldest(struct uip_conn *conn, void *buf);
+
+/* Drop all segments of conn */
+void uip_sndwnd_flush(struct uip_conn *conn);
+
+#endif /* UIP_SNDWND_H */
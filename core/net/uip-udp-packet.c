@@ -41,11 +41,19 @@
 #include "contiki-conf.h"
 
 extern u16_t uip_slen;
+#if UIP_CONF_IPV6
+/* In tcpip.c, only meant for the batches sent from here */
+extern u8_t tcpip_ipv6_output_again(void);
+#endif /* UIP_CONF_IPV6 */
 
 #include "net/uip-udp-packet.h"
+#include "net/tcpip.h"
 
 #include <string.h>
 
+#define UIP_IP_BUF ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_UDP_BUF ((struct uip_udp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+
 
 /*---------------------------------------------------------------------------*/
 void
@@ -89,3 +97,110 @@ uip_udp_packet_sendto(struct uip_udp_conn *c, const void *data, int len,
   c->rport = curport;
 }
 /*---------------------------------------------------------------------------*/
+int
+uip_udp_packet_send_batch(struct uip_udp_conn *c,
+                          const struct uip_udp_packet_vec *vec, int count)
+{
+#if UIP_UDP
+#if UIP_CONF_IPV6
+  u8_t hdr[UIP_IPUDPH_LEN];
+  u8_t have_hdr;
+  int i, len;
+
+  have_hdr = 0;
+  for(i = 0; i < count; i++) {
+    len = vec[i].len;
+    if(len > UIP_BUFSIZE - UIP_LLH_LEN - UIP_IPUDPH_LEN) {
+      len = UIP_BUFSIZE - UIP_LLH_LEN - UIP_IPUDPH_LEN;
+    }
+    if(len <= 0) {
+      continue;
+    }
+
+    if(!have_hdr) {
+      /* The first datagram goes all the way through uIP. We keep its
+         headers, which are the same for all datagrams of the batch
+         but for the lengths and the checksum. */
+      uip_udp_conn = c;
+      uip_slen = len;
+      memcpy(&uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN], vec[i].data, len);
+      uip_process(UIP_UDP_SEND_CONN);
+      uip_slen = 0;
+      if(uip_len == 0) {
+        return i;
+      }
+      memcpy(hdr, &uip_buf[UIP_LLH_LEN], UIP_IPUDPH_LEN);
+      have_hdr = 1;
+      tcpip_ipv6_output();
+      continue;
+    }
+
+    memcpy(&uip_buf[UIP_LLH_LEN], hdr, UIP_IPUDPH_LEN);
+    memcpy(&uip_buf[UIP_LLH_LEN + UIP_IPUDPH_LEN], vec[i].data, len);
+    uip_len = len + UIP_IPUDPH_LEN;
+    uip_ext_len = 0;
+    UIP_IP_BUF->len[0] = ((uip_len - UIP_IPH_LEN) >> 8);
+    UIP_IP_BUF->len[1] = ((uip_len - UIP_IPH_LEN) & 0xff);
+    UIP_UDP_BUF->udplen = UIP_HTONS(len + UIP_UDPH_LEN);
+    UIP_UDP_BUF->udpchksum = 0;
+#if UIP_UDP_CHECKSUMS
+    UIP_UDP_BUF->udpchksum = ~(uip_udpchksum());
+    if(UIP_UDP_BUF->udpchksum == 0) {
+      UIP_UDP_BUF->udpchksum = 0xffff;
+    }
+#endif /* UIP_UDP_CHECKSUMS */
+
+    /* The others go to the same next hop as the first datagram.
+       If that one is waiting for address resolution instead, stop
+       here: the rest would only push it out of the packet queue. */
+    if(!tcpip_ipv6_output_again()) {
+      uip_len = 0;
+      uip_ext_len = 0;
+      return i;
+    }
+    UIP_STAT(++uip_stat.udp.sent);
+    UIP_STAT(++uip_stat.ip.sent);
+  }
+  return count;
+#else /* UIP_CONF_IPV6 */
+  int i;
+
+  /* An IPv4 datagram needs a new IP ID and header checksum, which
+     only uIP can make, and the output function resolves the next hop
+     itself. */
+  for(i = 0; i < count; i++) {
+    uip_udp_packet_send(c, vec[i].data, vec[i].len);
+  }
+  return count;
+#endif /* UIP_CONF_IPV6 */
+#else /* UIP_UDP */
+  return 0;
+#endif /* UIP_UDP */
+}
+/*---------------------------------------------------------------------------*/
+int
+uip_udp_packet_sendto_batch(struct uip_udp_conn *c,
+                            const struct uip_udp_packet_vec *vec, int count,
+                            const uip_ipaddr_t *toaddr, uint16_t toport)
+{
+  uip_ipaddr_t curaddr;
+  uint16_t curport;
+  int sent;
+
+  /* Save current IP addr/port. */
+  uip_ipaddr_copy(&curaddr, &c->ripaddr);
+  curport = c->rport;
+
+  /* Load new IP addr/port */
+  uip_ipaddr_copy(&c->ripaddr, toaddr);
+  c->rport = toport;
+
+  sent = uip_udp_packet_send_batch(c, vec, count);
+
+  /* Restore old IP addr/port */
+  uip_ipaddr_copy(&c->ripaddr, &curaddr);
+  c->rport = curport;
+
+  return sent;
+}
+/*---------------------------------------------------------------------------*/
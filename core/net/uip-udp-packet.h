@@ -47,4 +47,24 @@ void uip_udp_packet_send(struct uip_udp_conn *c, const void *data, int len);
 void uip_udp_packet_sendto(struct uip_udp_conn *c, const void *data, int len,
 			   const uip_ipaddr_t *toaddr, uint16_t toport);
 
+/* The payload of one datagram of a batch */
+struct uip_udp_packet_vec {
+  const void *data;
+  int len;
+};
+
+/* Send count datagrams on c, one for each payload in vec. The
+   headers are built and the next hop is found once, for the first
+   datagram, and reused for the others. Returns the number of
+   payloads sent, empty ones included. With IPv6, the batch stops
+   after the first datagram if that one has to wait for address
+   resolution; the caller may send the rest again later. */
+int uip_udp_packet_send_batch(struct uip_udp_conn *c,
+                              const struct uip_udp_packet_vec *vec,
+                              int count);
+int uip_udp_packet_sendto_batch(struct uip_udp_conn *c,
+                                const struct uip_udp_packet_vec *vec,
+                                int count, const uip_ipaddr_t *toaddr,
+                                uint16_t toport);
+
 #endif /* __UIP_UDP_PACKET_H__ */
@@ -0,0 +1,121 @@
+#include <string.h>
+
+#include "net/uip.h"
+
+#if UIP_UDP && UIP_UDP_QUEUE
+
+#include "lib/memb.h"
+
+#include "net/uip-udp-queue.h"
+
+MEMB(dgrams_memb, struct uip_udp_queue_dgram, UIP_UDP_QUEUE);
+
+#if UIP_STATISTICS
+struct uip_udp_queue_stats uip_udp_queue_stats;
+#endif /* UIP_STATISTICS */
+
+#define UDPIP_BUF ((struct uip_udpip_hdr *)&uip_buf[UIP_LLH_LEN])
+#if UIP_CONF_IPV6
+#define UDP_BUF ((struct uip_udp_hdr *)&uip_buf[uip_l2_l3_hdr_len])
+#else /* UIP_CONF_IPV6 */
+#define UDP_BUF ((struct uip_udp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+#endif /* UIP_CONF_IPV6 */
+
+/*---------------------------------------------------------------------------*/
+void
+uip_udp_queue_attach(struct uip_udp_conn *conn,
+                     struct uip_udp_queue *queue, u8_t depth)
+{
+  queue->dgram = NULL;
+  queue->len = 0;
+  queue->depth = depth;
+  queue->posted = 0;
+  queue->drops = 0;
+  conn->queue = queue;
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_udp_queue_detach(struct uip_udp_conn *conn)
+{
+  if(conn->queue != NULL) {
+    uip_udp_queue_flush(conn->queue);
+    conn->queue = NULL;
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+uip_udp_queue_input(struct uip_udp_queue *queue)
+{
+  struct uip_udp_queue_dgram *d, **dp;
+
+  if(uip_datalen() > UIP_UDP_QUEUE_BUFSIZE) {
+    UIP_STAT(++uip_udp_queue_stats.toolong);
+    queue->drops++;
+    return 0;
+  }
+  if(queue->len >= queue->depth) {
+    UIP_STAT(++uip_udp_queue_stats.full);
+    queue->drops++;
+    return 0;
+  }
+  d = memb_alloc(&dgrams_memb);
+  if(d == NULL) {
+    UIP_STAT(++uip_udp_queue_stats.nomem);
+    queue->drops++;
+    return 0;
+  }
+
+  d->next = NULL;
+  uip_ipaddr_copy(&d->srcipaddr, &UDPIP_BUF->srcipaddr);
+  d->srcport = UDP_BUF->srcport;
+  d->len = uip_datalen();
+  memcpy(d->data, uip_appdata, d->len);
+
+  for(dp = &queue->dgram; *dp != NULL; dp = &(*dp)->next);
+  *dp = d;
+  return ++queue->len;
+}
+/*---------------------------------------------------------------------------*/
+int
+uip_udp_queue_get(struct uip_udp_queue *queue, void *buf, u16_t size,
+                  uip_ipaddr_t *srcipaddr, u16_t *srcport)
+{
+  struct uip_udp_queue_dgram *d = queue->dgram;
+
+  if(d == NULL) {
+    return -1;
+  }
+  if(size > d->len) {
+    size = d->len;
+  }
+  memcpy(buf, d->data, size);
+  if(srcipaddr != NULL) {
+    uip_ipaddr_copy(srcipaddr, &d->srcipaddr);
+  }
+  if(srcport != NULL) {
+    *srcport = d->srcport;
+  }
+
+  queue->dgram = d->next;
+  if(--queue->len == 0) {
+    queue->posted = 0;
+  }
+  memb_free(&dgrams_memb, d);
+  return size;
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_udp_queue_flush(struct uip_udp_queue *queue)
+{
+  struct uip_udp_queue_dgram *d;
+
+  while(queue->dgram != NULL) {
+    d = queue->dgram;
+    queue->dgram = d->next;
+    memb_free(&dgrams_memb, d);
+  }
+  queue->len = 0;
+  queue->posted = 0;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* UIP_UDP && UIP_UDP_QUEUE */
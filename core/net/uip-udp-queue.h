@@ -0,0 +1,76 @@
+#ifndef UIP_UDP_QUEUE_H
+#define UIP_UDP_QUEUE_H
+
+#include "net/uip.h"
+
+/* Largest UDP payload that a queue keeps; longer datagrams are
+   dropped */
+#ifdef UIP_CONF_UDP_QUEUE_BUFSIZE
+#define UIP_UDP_QUEUE_BUFSIZE UIP_CONF_UDP_QUEUE_BUFSIZE
+#else
+#define UIP_UDP_QUEUE_BUFSIZE (UIP_BUFSIZE - UIP_LLH_LEN - UIP_IPUDPH_LEN)
+#endif
+
+/* A received datagram, waiting for the application */
+struct uip_udp_queue_dgram {
+  struct uip_udp_queue_dgram *next;
+  uip_ipaddr_t srcipaddr;
+  u16_t srcport;
+  u16_t len;
+  u8_t data[UIP_UDP_QUEUE_BUFSIZE];
+};
+
+/* The receive queue of a UDP connection, oldest datagram first. The
+   datagrams come from a pool of UIP_UDP_QUEUE buffers shared by all
+   queues. */
+struct uip_udp_queue {
+  struct uip_udp_queue_dgram *dgram;
+  u8_t len;
+  u8_t depth;
+  u8_t posted;         /* The process has been told about the
+                          datagrams and has not emptied the queue yet */
+  u16_t drops;         /* Datagrams dropped because the queue or the
+                          pool was full, or they were too long */
+};
+
+#if UIP_STATISTICS
+struct uip_udp_queue_stats {
+  uip_stats_t full;             /**< Dropped, queue at its depth. */
+  uip_stats_t nomem;            /**< Dropped, no buffer in the pool. */
+  uip_stats_t toolong;          /**< Dropped, longer than
+                                   UIP_UDP_QUEUE_BUFSIZE. */
+};
+
+extern struct uip_udp_queue_stats uip_udp_queue_stats;
+#endif /* UIP_STATISTICS */
+
+/* Keep the datagrams received on conn in queue, at most depth of
+   them. The application takes them out with uip_udp_queue_get() when
+   it is ready, instead of handling them in the tcpip_event. It gets
+   one tcpip_event for datagrams arriving in an empty queue, and the
+   next one only after it has emptied the queue. */
+void uip_udp_queue_attach(struct uip_udp_conn *conn,
+                          struct uip_udp_queue *queue, u8_t depth);
+
+/* Drop the datagrams of the queue of conn and deliver new ones in the
+   tcpip_event again */
+void uip_udp_queue_detach(struct uip_udp_conn *conn);
+
+/* Append the datagram in uip_buf to the queue. Returns the number of
+   datagrams in the queue, 0 if the datagram was dropped. */
+int uip_udp_queue_input(struct uip_udp_queue *queue);
+
+/* Copy the payload of the oldest datagram to buf, at most size
+   bytes, and remove it from the queue. The sender is stored in
+   srcipaddr and srcport unless they are NULL. Returns the number of
+   bytes copied, or -1 if the queue is empty. */
+int uip_udp_queue_get(struct uip_udp_queue *queue, void *buf, u16_t size,
+                      uip_ipaddr_t *srcipaddr, u16_t *srcport);
+
+/* Drop all datagrams of the queue */
+void uip_udp_queue_flush(struct uip_udp_queue *queue);
+
+#define uip_udp_queue_len(queue) ((queue)->len)
+#define uip_udp_queue_drops(queue) ((queue)->drops)
+
+#endif /* UIP_UDP_QUEUE_H */
@@ -75,6 +75,7 @@
 #include "net/uipopt.h"
 #include "net/uip_arp.h"
 #include "net/uip_arch.h"
+#include "net/uip-sndwnd.h"
 
 #if !UIP_CONF_IPV6 /* If UIP_CONF_IPV6 is defined, we compile the
 		      uip6.c file instead of this one. Therefore
@@ -163,6 +164,18 @@ struct uip_udp_conn *uip_udp_conn;
 struct uip_udp_conn uip_udp_conns[UIP_UDP_CONNS];
 #endif /* UIP_UDP */
 
+#if UIP_DEMUX_HASH
+/* The connection that last received a packet, by a hash of the ports
+   and the source address of the packet. A slot is only a hint: it is
+   checked against the connection before it is used. */
+static struct uip_conn *tcp_demux[UIP_DEMUX_HASH];
+#if UIP_UDP
+static struct uip_udp_conn *udp_demux[UIP_DEMUX_HASH];
+#endif /* UIP_UDP */
+static u16_t demux;          /* The slot of the packet being
+				processed. */
+#endif /* UIP_DEMUX_HASH */
+
 static u16_t ipid;           /* Ths ipid variable is an increasing
 				number that is used for the IP ID
 				field. */
@@ -181,6 +194,12 @@ static u16_t lastport;       /* Keeps track of the last port used for
 u8_t uip_acc32[4];
 static u8_t c, opt;
 static u16_t tmp16;
+#if UIP_TCP_SNDWND
+/* Offset of the segment being sent from the oldest unacknowledged
+   byte, and whether the RTT of acknowledged data may be measured. */
+static u16_t sndoff;
+static u8_t timed;
+#endif /* UIP_TCP_SNDWND */
 
 /* Structures and definitions. */
 #define TCP_FIN 0x01
@@ -367,6 +386,101 @@ uip_udpchksum(void)
 #endif /* UIP_UDP_CHECKSUMS */
 #endif /* UIP_ARCH_CHKSUM */
 /*---------------------------------------------------------------------------*/
+u16_t
+uip_chksum_update(u16_t chksum, const void *olddata, const void *newdata,
+                  u16_t len)
+{
+  const u8_t *o = olddata;
+  const u8_t *n = newdata;
+  u32_t sum;
+
+  /* HC' = ~(~HC + ~m + m') */
+  sum = (u16_t)~uip_ntohs(chksum);
+  while(len > 1) {
+    sum += (u16_t)~((o[0] << 8) + o[1]);
+    sum += (n[0] << 8) + n[1];
+    o += 2;
+    n += 2;
+    len -= 2;
+  }
+  if(len > 0) {
+    sum += (u16_t)~(o[0] << 8);
+    sum += n[0] << 8;
+  }
+  while(sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  return uip_htons((u16_t)~sum);
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_DEMUX_HASH
+static u16_t
+demux_hash(u16_t lport, u16_t rport, const uip_ipaddr_t *ripaddr)
+{
+  u8_t i;
+  u16_t h;
+
+  h = lport + rport;
+  for(i = 0; i < sizeof(uip_ipaddr_t) / 2; ++i) {
+    h = ((h << 3) | (h >> 13)) ^ ripaddr->u16[i];
+  }
+  return h % UIP_DEMUX_HASH;
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_demux_flush(void)
+{
+  memset(tcp_demux, 0, sizeof(tcp_demux));
+#if UIP_UDP
+  memset(udp_demux, 0, sizeof(udp_demux));
+#endif /* UIP_UDP */
+}
+#endif /* UIP_DEMUX_HASH */
+/*---------------------------------------------------------------------------*/
+/* Check if the incoming segment belongs to an active connection. */
+static u8_t
+tcp_conn_match(struct uip_conn *conn)
+{
+  return conn->tcpstateflags != UIP_CLOSED &&
+    BUF->destport == conn->lport &&
+    BUF->srcport == conn->rport &&
+    uip_ipaddr_cmp(&BUF->srcipaddr, &conn->ripaddr);
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_UDP
+/* If the local UDP port is non-zero, the connection is considered to
+   be used. If so, the local port number is checked against the
+   destination port number in the received packet. If the two port
+   numbers match, the remote port number is checked if the connection
+   is bound to a remote port. Finally, if the connection is bound to a
+   remote IP address, the source IP address of the packet is
+   checked. */
+static u8_t
+udp_conn_match(struct uip_udp_conn *conn)
+{
+  return conn->lport != 0 &&
+    UDPBUF->destport == conn->lport &&
+    (conn->rport == 0 ||
+     UDPBUF->srcport == conn->rport) &&
+    (uip_ipaddr_cmp(&conn->ripaddr, &uip_all_zeroes_addr) ||
+     uip_ipaddr_cmp(&conn->ripaddr, &uip_broadcast_addr) ||
+     uip_ipaddr_cmp(&BUF->srcipaddr, &conn->ripaddr));
+}
+#if UIP_DEMUX_HASH
+/* A connection bound to a remote port and address matches a single
+   flow. Only such connections are kept in udp_demux[], because a
+   connection with wildcards may match packets that the linear search
+   would give to another connection. */
+static u8_t
+udp_conn_specified(struct uip_udp_conn *conn)
+{
+  return conn->rport != 0 &&
+    !uip_ipaddr_cmp(&conn->ripaddr, &uip_all_zeroes_addr) &&
+    !uip_ipaddr_cmp(&conn->ripaddr, &uip_broadcast_addr);
+}
+#endif /* UIP_DEMUX_HASH */
+#endif /* UIP_UDP */
+/*---------------------------------------------------------------------------*/
 void
 uip_init(void)
 {
@@ -376,6 +490,9 @@ uip_init(void)
   for(c = 0; c < UIP_CONNS; ++c) {
     uip_conns[c].tcpstateflags = UIP_CLOSED;
   }
+#if UIP_TCP_SNDWND
+  uip_sndwnd_init();
+#endif /* UIP_TCP_SNDWND */
 #if UIP_ACTIVE_OPEN || UIP_UDP
   lastport = 1024;
 #endif /* UIP_ACTIVE_OPEN || UIP_UDP */
@@ -385,6 +502,10 @@ uip_init(void)
     uip_udp_conns[c].lport = 0;
   }
 #endif /* UIP_UDP */
+
+#if UIP_DEMUX_HASH
+  uip_demux_flush();
+#endif /* UIP_DEMUX_HASH */
   
 
   /* IPv4 initialization. */
@@ -455,6 +576,14 @@ uip_connect(uip_ipaddr_t *ripaddr, u16_t rport)
   conn->lport = uip_htons(lastport);
   conn->rport = rport;
   uip_ipaddr_copy(&conn->ripaddr, ripaddr);
+#if UIP_TCP_SNDWND
+  uip_sndwnd_flush(conn);
+  conn->sndwnd = 0;
+  conn->snd_wnd = 0;
+#endif /* UIP_TCP_SNDWND */
+#if UIP_TCP_DELACK
+  conn->delack = 0;
+#endif /* UIP_TCP_DELACK */
   
   return conn;
 }
@@ -501,6 +630,14 @@ uip_udp_new(const uip_ipaddr_t *ripaddr, u16_t rport)
     uip_ipaddr_copy(&conn->ripaddr, ripaddr);
   }
   conn->ttl = UIP_TTL;
+#if UIP_UDP_QUEUE
+  /* Return the datagrams of a queue left behind by a connection that
+     was removed without uip_udp_remove() */
+  uip_udp_queue_detach(conn);
+#endif /* UIP_UDP_QUEUE */
+#if UIP_DEMUX_HASH
+  uip_demux_flush();
+#endif /* UIP_DEMUX_HASH */
   
   return conn;
 }
@@ -687,7 +824,11 @@ uip_process(u8_t flag)
      particular connection. */
   if(flag == UIP_POLL_REQUEST) {
     if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
-       !uip_outstanding(uip_connr)) {
+       (!uip_outstanding(uip_connr)
+#if UIP_TCP_SNDWND
+	|| uip_sndwnd_room(uip_connr) > 0
+#endif /* UIP_TCP_SNDWND */
+	)) {
 	uip_flags = UIP_POLL;
 	UIP_APPCALL();
 	goto appsend;
@@ -742,6 +883,9 @@ uip_process(u8_t flag)
 	       uip_connr->tcpstateflags == UIP_SYN_RCVD) &&
 	      uip_connr->nrtx == UIP_MAXSYNRTX)) {
 	    uip_connr->tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_SNDWND
+	    uip_sndwnd_flush(uip_connr);
+#endif /* UIP_TCP_SNDWND */
 
 	    /* We call UIP_APPCALL() with uip_flags set to
 	       UIP_TIMEDOUT to inform the application that the
@@ -781,6 +925,12 @@ uip_process(u8_t flag)
 #endif /* UIP_ACTIVE_OPEN */
 	    
 	  case UIP_ESTABLISHED:
+#if UIP_TCP_SNDWND
+	    /* With a send window, we have the data ourselves. */
+	    if(uip_connr->sndq != NULL) {
+	      goto tcp_send_oldest;
+	    }
+#endif /* UIP_TCP_SNDWND */
 	    /* In the ESTABLISHED state, we call upon the application
                to do the actual retransmit after which we jump into
                the code for sending out the packet (the apprexmit
@@ -797,6 +947,15 @@ uip_process(u8_t flag)
 	    
 	  }
 	}
+#if UIP_TCP_SNDWND
+	/* The application may send more while data is in flight. */
+	if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
+	   uip_sndwnd_room(uip_connr) > 0) {
+	  uip_flags = UIP_POLL;
+	  UIP_APPCALL();
+	  goto appsend;
+	}
+#endif /* UIP_TCP_SNDWND */
       } else if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
 	/* If there was no need for a retransmission, we poll the
            application for new data. */
@@ -805,6 +964,14 @@ uip_process(u8_t flag)
 	goto appsend;
       }
     }
+#if UIP_TCP_DELACK
+    /* Send the ACK for data that was received since the last
+       timer, if nothing else has carried it. */
+    if(uip_connr->delack > 0 &&
+       (uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
+      goto tcp_send_ack;
+    }
+#endif /* UIP_TCP_DELACK */
     goto drop;
   }
 #if UIP_UDP
@@ -1112,23 +1279,25 @@ uip_process(u8_t flag)
   }
 
   /* Demultiplex this UDP packet between the UDP "connections". */
+#if UIP_DEMUX_HASH
+  /* First try the connection that the last packet with the same ports
+     and source address went to. */
+  demux = demux_hash(UDPBUF->destport, UDPBUF->srcport, &BUF->srcipaddr);
+  uip_udp_conn = udp_demux[demux];
+  if(uip_udp_conn != NULL && udp_conn_specified(uip_udp_conn) &&
+     udp_conn_match(uip_udp_conn)) {
+    goto udp_found;
+  }
+#endif /* UIP_DEMUX_HASH */
   for(uip_udp_conn = &uip_udp_conns[0];
       uip_udp_conn < &uip_udp_conns[UIP_UDP_CONNS];
       ++uip_udp_conn) {
-    /* If the local UDP port is non-zero, the connection is considered
-       to be used. If so, the local port number is checked against the
-       destination port number in the received packet. If the two port
-       numbers match, the remote port number is checked if the
-       connection is bound to a remote port. Finally, if the
-       connection is bound to a remote IP address, the source IP
-       address of the packet is checked. */
-    if(uip_udp_conn->lport != 0 &&
-       UDPBUF->destport == uip_udp_conn->lport &&
-       (uip_udp_conn->rport == 0 ||
-        UDPBUF->srcport == uip_udp_conn->rport) &&
-       (uip_ipaddr_cmp(&uip_udp_conn->ripaddr, &uip_all_zeroes_addr) ||
-	uip_ipaddr_cmp(&uip_udp_conn->ripaddr, &uip_broadcast_addr) ||
-	uip_ipaddr_cmp(&BUF->srcipaddr, &uip_udp_conn->ripaddr))) {
+    if(udp_conn_match(uip_udp_conn)) {
+#if UIP_DEMUX_HASH
+      if(udp_conn_specified(uip_udp_conn)) {
+        udp_demux[demux] = uip_udp_conn;
+      }
+#endif /* UIP_DEMUX_HASH */
       goto udp_found;
     }
   }
@@ -1235,12 +1404,19 @@ uip_process(u8_t flag)
   
   /* Demultiplex this segment. */
   /* First check any active connections. */
+#if UIP_DEMUX_HASH
+  demux = demux_hash(BUF->destport, BUF->srcport, &BUF->srcipaddr);
+  uip_connr = tcp_demux[demux];
+  if(uip_connr != NULL && tcp_conn_match(uip_connr)) {
+    goto found;
+  }
+#endif /* UIP_DEMUX_HASH */
   for(uip_connr = &uip_conns[0]; uip_connr <= &uip_conns[UIP_CONNS - 1];
       ++uip_connr) {
-    if(uip_connr->tcpstateflags != UIP_CLOSED &&
-       BUF->destport == uip_connr->lport &&
-       BUF->srcport == uip_connr->rport &&
-       uip_ipaddr_cmp(&BUF->srcipaddr, &uip_connr->ripaddr)) {
+    if(tcp_conn_match(uip_connr)) {
+#if UIP_DEMUX_HASH
+      tcp_demux[demux] = uip_connr;
+#endif /* UIP_DEMUX_HASH */
       goto found;
     }
   }
@@ -1365,6 +1541,14 @@ uip_process(u8_t flag)
   uip_connr->snd_nxt[2] = iss[2];
   uip_connr->snd_nxt[3] = iss[3];
   uip_connr->len = 1;
+#if UIP_TCP_SNDWND
+  uip_sndwnd_flush(uip_connr);
+  uip_connr->sndwnd = 0;
+  uip_connr->snd_wnd = 0;
+#endif /* UIP_TCP_SNDWND */
+#if UIP_TCP_DELACK
+  uip_connr->delack = 0;
+#endif /* UIP_TCP_DELACK */
 
   /* rcv_nxt should be the seqno from the incoming packet + 1. */
   uip_connr->rcv_nxt[3] = BUF->seqno[3];
@@ -1438,6 +1622,9 @@ uip_process(u8_t flag)
      before we accept the reset. */
   if(BUF->flags & TCP_RST) {
     uip_connr->tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_SNDWND
+    uip_sndwnd_flush(uip_connr);
+#endif /* UIP_TCP_SNDWND */
     UIP_LOG("tcp: got reset, aborting connection.");
     uip_flags = UIP_ABORT;
     UIP_APPCALL();
@@ -1473,6 +1660,36 @@ uip_process(u8_t flag)
      data. If so, we update the sequence number, reset the length of
      the outstanding data, calculate RTT estimations, and reset the
      retransmission timer. */
+#if UIP_TCP_SNDWND
+  /* With a send window, the ACK may cover only part of the data in
+     flight. An ACK that covers nothing new, carries no data and does
+     not change the window is a duplicate; after a few of them, the
+     oldest segment was probably lost and we send it again at once. */
+  if(uip_connr->sndq != NULL) {
+    if(BUF->flags & TCP_ACK) {
+      if(uip_sndwnd_ack(uip_connr, BUF->ackno, &timed) > 0) {
+        uip_connr->dupacks = 0;
+        uip_connr->nrtx = 0;
+        if(timed) {
+          goto rtt_estimate;
+        }
+        goto ackdata;
+      }
+      if(uip_len == 0 &&
+         (BUF->flags & (TCP_SYN | TCP_FIN)) == 0 &&
+         BUF->wnd[0] == (uip_connr->snd_wnd >> 8) &&
+         BUF->wnd[1] == (uip_connr->snd_wnd & 0xff) &&
+         BUF->ackno[0] == uip_connr->snd_nxt[0] &&
+         BUF->ackno[1] == uip_connr->snd_nxt[1] &&
+         BUF->ackno[2] == uip_connr->snd_nxt[2] &&
+         BUF->ackno[3] == uip_connr->snd_nxt[3] &&
+         ++uip_connr->dupacks == UIP_SNDWND_DUPACKS) {
+        UIP_STAT(++uip_stat.tcp.rexmit);
+        goto tcp_send_oldest;
+      }
+    }
+  } else
+#endif /* UIP_TCP_SNDWND */
   if((BUF->flags & TCP_ACK) && uip_outstanding(uip_connr)) {
     uip_add32(uip_connr->snd_nxt, uip_connr->len);
 
@@ -1485,8 +1702,14 @@ uip_process(u8_t flag)
       uip_connr->snd_nxt[1] = uip_acc32[1];
       uip_connr->snd_nxt[2] = uip_acc32[2];
       uip_connr->snd_nxt[3] = uip_acc32[3];
+
+      /* Reset length of outstanding data. */
+      uip_connr->len = 0;
 	
       /* Do RTT estimation, unless we have done retransmissions. */
+#if UIP_TCP_SNDWND
+    rtt_estimate:
+#endif /* UIP_TCP_SNDWND */
       if(uip_connr->nrtx == 0) {
 	signed char m;
 	m = uip_connr->rto - uip_connr->timer;
@@ -1501,17 +1724,26 @@ uip_process(u8_t flag)
 	uip_connr->rto = (uip_connr->sa >> 3) + uip_connr->sv;
 
       }
+#if UIP_TCP_SNDWND
+    ackdata:
+#endif /* UIP_TCP_SNDWND */
       /* Set the acknowledged flag. */
       uip_flags = UIP_ACKDATA;
       /* Reset the retransmission timer. */
       uip_connr->timer = uip_connr->rto;
-
-      /* Reset length of outstanding data. */
-      uip_connr->len = 0;
     }
     
   }
 
+#if UIP_TCP_SNDWND
+  /* Remember the window the peer advertises, also in the segment that
+     completes the handshake, so that the send window can be filled
+     right away. */
+  if(BUF->flags & TCP_ACK) {
+    uip_connr->snd_wnd = ((u16_t)BUF->wnd[0] << 8) + (u16_t)BUF->wnd[1];
+  }
+#endif /* UIP_TCP_SNDWND */
+
   /* Do different things depending on in what state the connection is. */
   switch(uip_connr->tcpstateflags & UIP_TS_MASK) {
     /* CLOSED and LISTEN are not handled here. CLOSE_WAIT is not
@@ -1707,10 +1939,30 @@ uip_process(u8_t flag)
       if(uip_flags & UIP_ABORT) {
 	uip_slen = 0;
 	uip_connr->tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_SNDWND
+	uip_sndwnd_flush(uip_connr);
+#endif /* UIP_TCP_SNDWND */
 	BUF->flags = TCP_RST | TCP_ACK;
 	goto tcp_send_nodata;
       }
 
+#if UIP_TCP_SNDWND
+      /* Our FIN must come after the data in flight, so a close waits
+	 until all of it has been acknowledged. */
+      if(uip_connr->sndwnd) {
+	if(uip_flags & UIP_CLOSE) {
+	  uip_connr->sndwnd |= UIP_SNDWND_CLOSE;
+	}
+	if(uip_connr->sndwnd & UIP_SNDWND_CLOSE) {
+	  uip_slen = 0;
+	  uip_flags &= ~UIP_CLOSE;
+	  if(!uip_outstanding(uip_connr)) {
+	    uip_flags |= UIP_CLOSE;
+	  }
+	}
+      }
+#endif /* UIP_TCP_SNDWND */
+
       if(uip_flags & UIP_CLOSE) {
 	uip_slen = 0;
 	uip_connr->len = 1;
@@ -1721,6 +1973,22 @@ uip_process(u8_t flag)
       }
 
       /* If uip_slen > 0, the application has data to be sent. */
+#if UIP_TCP_SNDWND
+      if(uip_slen > 0 && uip_connr->sndwnd) {
+	/* With a send window, the data goes after the data in flight,
+	   if there is room for it. */
+	tmp16 = uip_sndwnd_room(uip_connr);
+	if(uip_slen > tmp16) {
+	  uip_slen = tmp16;
+	}
+	sndoff = uip_connr->len;
+	if(uip_slen == 0 ||
+	   !uip_sndwnd_push(uip_connr, uip_sappdata, uip_slen)) {
+	  uip_slen = 0;
+	  sndoff = 0;
+	}
+      } else
+#endif /* UIP_TCP_SNDWND */
       if(uip_slen > 0) {
 
 	/* If the connection has acknowledged data, the contents of
@@ -1752,6 +2020,11 @@ uip_process(u8_t flag)
 	  uip_slen = uip_connr->len;
 	}
       }
+#if UIP_TCP_SNDWND
+      /* With data in flight, the retransmission count is that of the
+	 oldest segment. */
+      if(uip_connr->sndq == NULL)
+#endif /* UIP_TCP_SNDWND */
       uip_connr->nrtx = 0;
     apprexmit:
       uip_appdata = uip_sappdata;
@@ -1761,6 +2034,12 @@ uip_process(u8_t flag)
       if(uip_slen > 0 && uip_connr->len > 0) {
 	/* Add the length of the IP and TCP headers. */
 	uip_len = uip_connr->len + UIP_TCPIP_HLEN;
+#if UIP_TCP_SNDWND
+	if(uip_connr->sndwnd) {
+	  /* Only the new data. */
+	  uip_len = uip_slen + UIP_TCPIP_HLEN;
+	}
+#endif /* UIP_TCP_SNDWND */
 	/* We always set the ACK flag in response packets. */
 	BUF->flags = TCP_ACK | TCP_PSH;
 	/* Send the packet. */
@@ -1769,10 +2048,23 @@ uip_process(u8_t flag)
       /* If there is no data to send, just send out a pure ACK if
 	 there is newdata. */
       if(uip_flags & UIP_NEWDATA) {
+#if UIP_TCP_DELACK
+	/* Hold the ACK back until enough segments have arrived or
+	   the periodic timer fires. */
+	if(++uip_connr->delack < UIP_TCP_DELACK) {
+	  goto drop;
+	}
+#endif /* UIP_TCP_DELACK */
 	uip_len = UIP_TCPIP_HLEN;
 	BUF->flags = TCP_ACK;
 	goto tcp_send_noopts;
       }
+#if UIP_TCP_DELACK
+      /* The periodic timer sends an ACK that was held back. */
+      if(flag == UIP_TIMER && uip_connr->delack > 0) {
+	goto tcp_send_ack;
+      }
+#endif /* UIP_TCP_DELACK */
     }
     goto drop;
   case UIP_LAST_ACK:
@@ -1842,6 +2134,14 @@ uip_process(u8_t flag)
   }
   goto drop;
   
+#if UIP_TCP_SNDWND
+  /* Send the oldest unacknowledged segment of the send window again. */
+ tcp_send_oldest:
+  uip_len = uip_sndwnd_oldest(uip_connr, uip_sappdata) + UIP_TCPIP_HLEN;
+  BUF->flags = TCP_ACK | TCP_PSH;
+  goto tcp_send_noopts;
+#endif /* UIP_TCP_SNDWND */
+
   /* We jump here when we are ready to send the packet, and just want
      to set the appropriate TCP sequence numbers in the TCP header. */
  tcp_send_ack:
@@ -1867,6 +2167,18 @@ uip_process(u8_t flag)
   BUF->seqno[1] = uip_connr->snd_nxt[1];
   BUF->seqno[2] = uip_connr->snd_nxt[2];
   BUF->seqno[3] = uip_connr->snd_nxt[3];
+#if UIP_TCP_DELACK
+  /* Every segment we send acknowledges the data received so far. */
+  uip_connr->delack = 0;
+#endif /* UIP_TCP_DELACK */
+#if UIP_TCP_SNDWND
+  if(sndoff > 0) {
+    /* New data is sent after the data already in flight. */
+    uip_add32(BUF->seqno, sndoff);
+    memcpy(BUF->seqno, uip_acc32, 4);
+    sndoff = 0;
+  }
+#endif /* UIP_TCP_SNDWND */
 
   BUF->proto = UIP_PROTO_TCP;
   
@@ -447,8 +447,27 @@ void uip_setipid(u16_t id);
     uip_process(UIP_UDP_TIMER); } while(0)
 #endif /* UIP_UDP */
 
-/** \brief Abandon the reassembly of the current packet */
-void uip_reass_over(void);
+/**
+ * \brief Abandon a reassembly whose timer ran out
+ *
+ * \param timer The expired etimer, as the data of the timer event
+ * \return Non-zero if timer belonged to a reassembly; uip_buf may then
+ * hold an ICMPv6 Time Exceeded message to send.
+ */
+u8_t uip_reass_over(void *timer);
+
+#if UIP_CONF_IPV6_REASSEMBLY && UIP_STATISTICS
+/** \brief IPv6 reassembly statistics */
+struct uip_reass_stats {
+  uip_stats_t reassembled;      /**< Datagrams reassembled. */
+  uip_stats_t timedout;         /**< Reassemblies abandoned when their
+                                   timer ran out. */
+  uip_stats_t dropped;          /**< Fragments dropped because all
+                                   reassembly contexts were busy. */
+};
+
+extern struct uip_reass_stats uip_reass_stats;
+#endif /* UIP_CONF_IPV6_REASSEMBLY && UIP_STATISTICS */
 
 /**
  * The uIP packet buffer.
@@ -482,7 +501,69 @@ typedef union {
   uint8_t u8[UIP_BUFSIZE];
 } uip_buf_t;
 
+#if UIP_BUFFER_POOL
+/**
+ * A packet buffer of the uIP buffer pool.
+ *
+ * One buffer of the pool is always the current uip_buf. The packet
+ * queue of uip-packetqueue and the 6lowpan reassembly swap buffers
+ * instead of copying. A driver
+ * that wants to receive while uIP still works on uip_buf, or to keep
+ * a packet until its transmission completes, can do the same:
+ \code
+ struct uip_pbuf *p = uip_pbuf_alloc();
+ if(p != NULL) {
+   p->len = hwread(&p->buf.u8[UIP_LLH_LEN], UIP_BUFSIZE - UIP_LLH_LEN);
+   uip_pbuf_attach(p);
+   tcpip_input();
+ }
+ \endcode
+ */
+struct uip_pbuf {
+  uip_buf_t buf;
+  u16_t len;                    /**< Packet length, as uip_len. */
+};
+
+CCIF extern struct uip_pbuf *uip_pbuf_current;
+#define uip_aligned_buf (uip_pbuf_current->buf)
+
+/**
+ * Get a free buffer from the pool.
+ *
+ * \return The buffer, or NULL if all buffers are in use.
+ */
+struct uip_pbuf *uip_pbuf_alloc(void);
+
+/**
+ * Return a buffer to the pool. The current uip_buf cannot be freed.
+ */
+void uip_pbuf_free(struct uip_pbuf *p);
+
+/**
+ * Make a buffer the current uip_buf and set uip_len from it. The
+ * previous uip_buf goes back to the pool.
+ */
+void uip_pbuf_attach(struct uip_pbuf *p);
+
+/**
+ * Take the current uip_buf away from uIP, recording uip_len in it,
+ * and give uIP a fresh, empty buffer in its place.
+ *
+ * \return The packet buffer, or NULL if the pool had no buffer to
+ * replace it with; uip_buf is then left alone.
+ */
+struct uip_pbuf *uip_pbuf_detach(void);
+
+/**
+ * Make a buffer the current uip_buf and set uip_len from it, and
+ * hand out the previous uip_buf, recording uip_len in it.
+ *
+ * \return The previous uip_buf.
+ */
+struct uip_pbuf *uip_pbuf_exchange(struct uip_pbuf *p);
+#else /* UIP_BUFFER_POOL */
 CCIF extern uip_buf_t uip_aligned_buf;
+#endif /* UIP_BUFFER_POOL */
 #define uip_buf (uip_aligned_buf.u8)
 
 
@@ -797,9 +878,49 @@ CCIF void uip_send(const void *data, int len);
  * the connection (which also is available by calling
  * uip_initialmss()).
  *
+ * On a connection with a send window, this is the amount of new
+ * data that can be sent right now, which may be 0.
+ *
  * \hideinitializer
  */
+#if UIP_TCP_SNDWND
+#define uip_mss()             (uip_conn->sndwnd ?               \
+                               uip_sndwnd_room(uip_conn) :      \
+                               uip_conn->mss)
+#else /* UIP_TCP_SNDWND */
 #define uip_mss()             (uip_conn->mss)
+#endif /* UIP_TCP_SNDWND */
+
+#if UIP_TCP_SNDWND
+#define UIP_SNDWND_ON    1
+#define UIP_SNDWND_CLOSE 2 /* uip_close() waits for the data in flight */
+
+/**
+ * Let the current connection have several segments in flight.
+ *
+ * Must be called when the connection is set up, i.e., when
+ * uip_connected() is non-zero, and needs UIP_CONF_TCP_SNDWND.
+ *
+ * On such a connection, uIP keeps a copy of the data the application
+ * sends until the data is acknowledged, and retransmits it by
+ * itself: the application is never asked to retransmit. Whenever
+ * the application is invoked, it may send up to uip_mss() bytes of
+ * new data, and uip_acked() tells that some of the data in flight
+ * has been acknowledged. uip_close() takes effect once all data has
+ * been acknowledged.
+ *
+ * \hideinitializer
+ */
+#define uip_sndwnd_enable() (uip_conn->sndwnd = UIP_SNDWND_ON)
+
+/**
+ * \internal
+ *
+ * The amount of new data the connection may send, 0 if it has no
+ * send window.
+ */
+u16_t uip_sndwnd_room(struct uip_conn *conn);
+#endif /* UIP_TCP_SNDWND */
 
 /**
  * Set up a new UDP connection.
@@ -837,7 +958,13 @@ struct uip_udp_conn *uip_udp_new(const uip_ipaddr_t *ripaddr, u16_t rport);
  *
  * \hideinitializer
  */
+#if UIP_UDP_QUEUE
+struct uip_udp_conn;
+void uip_udp_queue_detach(struct uip_udp_conn *conn);
+#define uip_udp_remove(conn) ((conn)->lport = 0, uip_udp_queue_detach(conn))
+#else /* UIP_UDP_QUEUE */
 #define uip_udp_remove(conn) (conn)->lport = 0
+#endif /* UIP_UDP_QUEUE */
 
 /**
  * Bind a UDP connection to a local port.
@@ -849,7 +976,20 @@ struct uip_udp_conn *uip_udp_new(const uip_ipaddr_t *ripaddr, u16_t rport);
  *
  * \hideinitializer
  */
+#if UIP_DEMUX_HASH
+#define uip_udp_bind(conn, port) ((conn)->lport = (port), uip_demux_flush())
+#else /* UIP_DEMUX_HASH */
 #define uip_udp_bind(conn, port) (conn)->lport = port
+#endif /* UIP_DEMUX_HASH */
+
+/**
+ * Forget which connections recently received packets.
+ *
+ * uIP calls this when a UDP connection is created or bound, since
+ * the new connection may be the one that should receive packets
+ * that went to another connection before.
+ */
+void uip_demux_flush(void);
 
 /**
  * Send a UDP datagram of length len on the current connection.
@@ -1313,6 +1453,19 @@ struct uip_conn {
   u8_t timer;         /**< The retransmission timer. */
   u8_t nrtx;          /**< The number of retransmissions for the last
 			 segment sent. */
+#if UIP_TCP_SNDWND
+  struct uip_sndwnd_seg *sndq; /**< Data sent but not acknowledged,
+                                  oldest first. */
+  u16_t snd_wnd;      /**< The window advertised by the remote host. */
+  u8_t sndwnd;        /**< UIP_SNDWND_ON if the connection has a send
+                         window. */
+  u8_t dupacks;       /**< Duplicate ACKs received for the oldest
+                         segment in flight. */
+#endif /* UIP_TCP_SNDWND */
+#if UIP_TCP_DELACK
+  u8_t delack;        /**< The number of received segments not yet
+                         acknowledged. */
+#endif /* UIP_TCP_DELACK */
 
   /** The application state. */
   uip_tcp_appstate_t appstate;
@@ -1351,6 +1504,10 @@ struct uip_udp_conn {
   u16_t lport;        /**< The local port number in network byte order. */
   u16_t rport;        /**< The remote port number in network byte order. */
   u8_t  ttl;          /**< Default time-to-live. */
+#if UIP_UDP_QUEUE
+  struct uip_udp_queue *queue; /**< Received datagrams waiting for the
+                                  application, or NULL. */
+#endif /* UIP_UDP_QUEUE */
 
   /** The application state. */
   uip_udp_appstate_t appstate;
@@ -2174,6 +2331,28 @@ u16_t uip_udpchksum(void);
  */
 u16_t uip_icmp6chksum(void);
 
+/**
+ * Update an Internet checksum after part of the data it covers has
+ * been rewritten.
+ *
+ * This avoids summing the whole packet again when a forwarder
+ * rewrites a few header fields. It implements equation 3 of RFC1624.
+ *
+ * \param chksum The checksum field as stored in the packet (network
+ * byte order).
+ *
+ * \param olddata The data before the rewrite.
+ *
+ * \param newdata The data after the rewrite.
+ *
+ * \param len The number of bytes rewritten. The rewritten data must
+ * start at an even offset from the start of the checksummed data.
+ *
+ * \return The new checksum field, in network byte order.
+ */
+u16_t uip_chksum_update(u16_t chksum, const void *olddata,
+                        const void *newdata, u16_t len);
+
 
 #endif /* __UIP_H__ */
 
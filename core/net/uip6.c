@@ -76,6 +76,7 @@
 #include "net/uip-icmp6.h"
 #include "net/uip-nd6.h"
 #include "net/uip-ds6.h"
+#include "net/uip-sndwnd.h"
 
 #include <string.h>
 
@@ -151,7 +152,7 @@ u8_t uip_ext_opt_offset = 0;
 /** \name Buffer defines
  *  @{
  */
-#define FBUF                             ((struct uip_tcpip_hdr *)&uip_reassbuf[0])
+#define FBUF                             ((struct uip_tcpip_hdr *)&ctx->buf[0])
 #define UIP_IP_BUF                          ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
 #define UIP_ICMP_BUF                      ((struct uip_icmp_hdr *)&uip_buf[uip_l2_l3_hdr_len])
 #define UIP_UDP_BUF                        ((struct uip_udp_hdr *)&uip_buf[uip_l2_l3_hdr_len])
@@ -169,9 +170,14 @@ u8_t uip_ext_opt_offset = 0;
  *  @{
  */
 /** Packet buffer for incoming and outgoing packets */
-#ifndef UIP_CONF_EXTERNAL_BUFFER
+#if UIP_BUFFER_POOL
+static struct uip_pbuf pbuf_pool[UIP_BUFFER_POOL];
+/* The first buffer of the pool starts out as uip_buf */
+static uint8_t pbuf_used[UIP_BUFFER_POOL] = { 1 };
+struct uip_pbuf *uip_pbuf_current = &pbuf_pool[0];
+#elif !defined(UIP_CONF_EXTERNAL_BUFFER)
 uip_buf_t uip_aligned_buf;
-#endif /* UIP_CONF_EXTERNAL_BUFFER */
+#endif /* UIP_BUFFER_POOL */
 
 /* The uip_appdata pointer points to application data. */
 void *uip_appdata;
@@ -248,6 +254,12 @@ static u8_t iss[4];
 u8_t uip_acc32[4];
 static u8_t opt;
 static u16_t tmp16;
+#if UIP_TCP_SNDWND
+/* Offset of the segment being sent from the oldest unacknowledged
+   byte, and whether the RTT of acknowledged data may be measured. */
+static u16_t sndoff;
+static u8_t timed;
+#endif /* UIP_TCP_SNDWND */
 #endif /* UIP_TCP */
 /** @} */
 
@@ -268,6 +280,24 @@ struct uip_udp_conn uip_udp_conns[UIP_UDP_CONNS];
 struct uip_icmp6_conn uip_icmp6_conns;
 #endif /*UIP_CONF_ICMP6*/
 
+/*---------------------------------------------------------------------------*/
+/** @{ \name Demultiplexing variables                                        */
+/*---------------------------------------------------------------------------*/
+#if UIP_DEMUX_HASH
+/* The connection that last received a packet, by a hash of the ports
+   and the source address of the packet. A slot is only a hint: it is
+   checked against the connection before it is used. */
+#if UIP_TCP
+static struct uip_conn *tcp_demux[UIP_DEMUX_HASH];
+#endif /* UIP_TCP */
+#if UIP_UDP
+static struct uip_udp_conn *udp_demux[UIP_DEMUX_HASH];
+#endif /* UIP_UDP */
+/* The slot of the packet being processed. */
+static u16_t demux;
+#endif /* UIP_DEMUX_HASH */
+/** @} */
+
 /*---------------------------------------------------------------------------*/
 /* Functions                                                                 */
 /*---------------------------------------------------------------------------*/
@@ -402,6 +432,165 @@ uip_udpchksum(void)
 #endif /* UIP_UDP && UIP_UDP_CHECKSUMS */
 #endif /* UIP_ARCH_CHKSUM */
 /*---------------------------------------------------------------------------*/
+u16_t
+uip_chksum_update(u16_t chksum, const void *olddata, const void *newdata,
+                  u16_t len)
+{
+  const u8_t *o = olddata;
+  const u8_t *n = newdata;
+  u32_t sum;
+
+  /* HC' = ~(~HC + ~m + m') */
+  sum = (u16_t)~uip_ntohs(chksum);
+  while(len > 1) {
+    sum += (u16_t)~((o[0] << 8) + o[1]);
+    sum += (n[0] << 8) + n[1];
+    o += 2;
+    n += 2;
+    len -= 2;
+  }
+  if(len > 0) {
+    sum += (u16_t)~(o[0] << 8);
+    sum += n[0] << 8;
+  }
+  while(sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  return uip_htons((u16_t)~sum);
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_BUFFER_POOL
+struct uip_pbuf *
+uip_pbuf_alloc(void)
+{
+  uint8_t i;
+
+  for(i = 0; i < UIP_BUFFER_POOL; i++) {
+    if(!pbuf_used[i]) {
+      pbuf_used[i] = 1;
+      pbuf_pool[i].len = 0;
+      return &pbuf_pool[i];
+    }
+  }
+  return NULL;
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_pbuf_free(struct uip_pbuf *p)
+{
+  if(p != NULL && p != uip_pbuf_current) {
+    pbuf_used[p - pbuf_pool] = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_pbuf_attach(struct uip_pbuf *p)
+{
+  if(p != uip_pbuf_current) {
+    pbuf_used[uip_pbuf_current - pbuf_pool] = 0;
+    uip_pbuf_current = p;
+  }
+  uip_len = p->len;
+}
+/*---------------------------------------------------------------------------*/
+struct uip_pbuf *
+uip_pbuf_detach(void)
+{
+  struct uip_pbuf *p, *fresh;
+
+  fresh = uip_pbuf_alloc();
+  if(fresh == NULL) {
+    return NULL;
+  }
+  p = uip_pbuf_current;
+  p->len = uip_len;
+  uip_pbuf_current = fresh;
+  uip_len = 0;
+  return p;
+}
+/*---------------------------------------------------------------------------*/
+struct uip_pbuf *
+uip_pbuf_exchange(struct uip_pbuf *p)
+{
+  struct uip_pbuf *prev;
+
+  prev = uip_pbuf_current;
+  prev->len = uip_len;
+  uip_pbuf_current = p;
+  uip_len = p->len;
+  return prev;
+}
+#endif /* UIP_BUFFER_POOL */
+/*---------------------------------------------------------------------------*/
+#if UIP_DEMUX_HASH
+static u16_t
+demux_hash(u16_t lport, u16_t rport, const uip_ipaddr_t *ripaddr)
+{
+  u8_t i;
+  u16_t h;
+
+  h = lport + rport;
+  for(i = 0; i < sizeof(uip_ipaddr_t) / 2; ++i) {
+    h = ((h << 3) | (h >> 13)) ^ ripaddr->u16[i];
+  }
+  return h % UIP_DEMUX_HASH;
+}
+/*---------------------------------------------------------------------------*/
+void
+uip_demux_flush(void)
+{
+#if UIP_TCP
+  memset(tcp_demux, 0, sizeof(tcp_demux));
+#endif /* UIP_TCP */
+#if UIP_UDP
+  memset(udp_demux, 0, sizeof(udp_demux));
+#endif /* UIP_UDP */
+}
+#endif /* UIP_DEMUX_HASH */
+/*---------------------------------------------------------------------------*/
+#if UIP_TCP
+/* Check if the incoming segment belongs to an active connection. */
+static u8_t
+tcp_conn_match(struct uip_conn *conn)
+{
+  return conn->tcpstateflags != UIP_CLOSED &&
+    UIP_TCP_BUF->destport == conn->lport &&
+    UIP_TCP_BUF->srcport == conn->rport &&
+    uip_ipaddr_cmp(&UIP_IP_BUF->srcipaddr, &conn->ripaddr);
+}
+#endif /* UIP_TCP */
+/*---------------------------------------------------------------------------*/
+#if UIP_UDP
+/* If the local UDP port is non-zero, the connection is considered to
+   be used. If so, the local port number is checked against the
+   destination port number in the received packet. If the two port
+   numbers match, the remote port number is checked if the connection
+   is bound to a remote port. Finally, if the connection is bound to a
+   remote IP address, the source IP address of the packet is
+   checked. */
+static u8_t
+udp_conn_match(struct uip_udp_conn *conn)
+{
+  return conn->lport != 0 &&
+    UIP_UDP_BUF->destport == conn->lport &&
+    (conn->rport == 0 ||
+     UIP_UDP_BUF->srcport == conn->rport) &&
+    (uip_is_addr_unspecified(&conn->ripaddr) ||
+     uip_ipaddr_cmp(&UIP_IP_BUF->srcipaddr, &conn->ripaddr));
+}
+#if UIP_DEMUX_HASH
+/* A connection bound to a remote port and address matches a single
+   flow. Only such connections are kept in udp_demux[], because a
+   connection with wildcards may match packets that the linear search
+   would give to another connection. */
+static u8_t
+udp_conn_specified(struct uip_udp_conn *conn)
+{
+  return conn->rport != 0 && !uip_is_addr_unspecified(&conn->ripaddr);
+}
+#endif /* UIP_DEMUX_HASH */
+#endif /* UIP_UDP */
+/*---------------------------------------------------------------------------*/
 void
 uip_init(void)
 {
@@ -415,6 +604,9 @@ uip_init(void)
   for(c = 0; c < UIP_CONNS; ++c) {
     uip_conns[c].tcpstateflags = UIP_CLOSED;
   }
+#if UIP_TCP_SNDWND
+  uip_sndwnd_init();
+#endif /* UIP_TCP_SNDWND */
 #endif /* UIP_TCP */
 
 #if UIP_ACTIVE_OPEN || UIP_UDP
@@ -426,6 +618,10 @@ uip_init(void)
     uip_udp_conns[c].lport = 0;
   }
 #endif /* UIP_UDP */
+
+#if UIP_DEMUX_HASH
+  uip_demux_flush();
+#endif /* UIP_DEMUX_HASH */
 }
 
 /*---------------------------------------------------------------------------*/
@@ -490,6 +686,14 @@ uip_connect(uip_ipaddr_t *ripaddr, u16_t rport)
   conn->lport = uip_htons(lastport);
   conn->rport = rport;
   uip_ipaddr_copy(&conn->ripaddr, ripaddr);
+#if UIP_TCP_SNDWND
+  uip_sndwnd_flush(conn);
+  conn->sndwnd = 0;
+  conn->snd_wnd = 0;
+#endif /* UIP_TCP_SNDWND */
+#if UIP_TCP_DELACK
+  conn->delack = 0;
+#endif /* UIP_TCP_DELACK */
   
   return conn;
 }
@@ -538,6 +742,14 @@ uip_udp_new(const uip_ipaddr_t *ripaddr, u16_t rport)
     uip_ipaddr_copy(&conn->ripaddr, ripaddr);
   }
   conn->ttl = uip_ds6_if.cur_hop_limit;
+#if UIP_UDP_QUEUE
+  /* Return the datagrams of a queue left behind by a connection that
+     was removed without uip_udp_remove() */
+  uip_udp_queue_detach(conn);
+#endif /* UIP_UDP_QUEUE */
+#if UIP_DEMUX_HASH
+  uip_demux_flush();
+#endif /* UIP_DEMUX_HASH */
   
   return conn;
 }
@@ -576,20 +788,36 @@ uip_listen(u16_t port)
 #if UIP_CONF_IPV6_REASSEMBLY
 #define UIP_REASS_BUFSIZE (UIP_BUFSIZE - UIP_LLH_LEN)
 
-static u8_t uip_reassbuf[UIP_REASS_BUFSIZE];
+/*
+ * One datagram being reassembled. Datagrams are told apart by source,
+ * destination and fragment identification, so fragments of different
+ * datagrams may arrive interleaved. The buffer comes first to keep the
+ * headers in it aligned.
+ */
+struct uip_reass_ctx {
+  u8_t buf[UIP_REASS_BUFSIZE];
+  /*the first byte of an IP fragment is aligned on an 8-byte boundary */
+  u8_t bitmap[UIP_REASS_BUFSIZE / (8 * 8)];
+  struct etimer timer;
+  u32_t id;
+  u16_t len;
+  u8_t flags;
+};
 
-static u8_t uip_reassbitmap[UIP_REASS_BUFSIZE / (8 * 8)];
-/*the first byte of an IP fragment is aligned on an 8-byte boundary */
+static struct uip_reass_ctx uip_reass_ctxs[UIP_CONF_IPV6_REASS_CONTEXTS];
 
 static const u8_t bitmap_bits[8] = {0xff, 0x7f, 0x3f, 0x1f,
                                     0x0f, 0x07, 0x03, 0x01};
-static u16_t uip_reasslen;
-static u8_t uip_reassflags;
+/* set when uip_reass() left an ICMP error message in uip_buf */
+static u8_t uip_reass_errmsg;
 
 #define UIP_REASS_FLAG_LASTFRAG 0x01
 #define UIP_REASS_FLAG_FIRSTFRAG 0x02
-#define UIP_REASS_FLAG_ERROR_MSG 0x04
+#define UIP_REASS_FLAG_INUSE 0x04
 
+#if UIP_STATISTICS
+struct uip_reass_stats uip_reass_stats;
+#endif /* UIP_STATISTICS */
 
 /*
  * See RFC 2460 for a description of fragmentation in IPv6
@@ -600,170 +828,202 @@ static u8_t uip_reassflags;
  *  +------------------+--------+--------------+
  */
 
+#define IP_MF   0x0001
 
-struct etimer uip_reass_timer; /* timer for reassembly */
-u8_t uip_reass_on; /* equal to 1 if we are currently reassembling a packet */
+/*---------------------------------------------------------------------------*/
+/*
+ * Find the reassembly context of the fragment in uip_buf, or start one
+ * in a free context. Returns NULL if all contexts are busy with other
+ * datagrams.
+ */
+static struct uip_reass_ctx *
+uip_reass_lookup(void)
+{
+  struct uip_reass_ctx *ctx, *victim = NULL;
 
-static u32_t uip_id; /* For every packet that is to be fragmented, the source
-                        node generates an Identification value that is present
-                        in all the fragments */
-#define IP_MF   0x0001
+  for(ctx = uip_reass_ctxs;
+      ctx < &uip_reass_ctxs[UIP_CONF_IPV6_REASS_CONTEXTS]; ctx++) {
+    if(!(ctx->flags & UIP_REASS_FLAG_INUSE)) {
+      if(victim == NULL) {
+        victim = ctx;
+      }
+    } else if(uip_ipaddr_cmp(&FBUF->srcipaddr, &UIP_IP_BUF->srcipaddr) &&
+              uip_ipaddr_cmp(&FBUF->destipaddr, &UIP_IP_BUF->destipaddr) &&
+              UIP_FRAG_BUF->id == ctx->id) {
+      return ctx;
+    }
+  }
+  if(victim == NULL) {
+    PRINTF("Already reassembling other paquets\n");
+    UIP_STAT(++uip_reass_stats.dropped);
+    return NULL;
+  }
 
+  ctx = victim;
+  /* We first write the unfragmentable part of IP header into the reassembly
+     buffer. The reset the other reassembly variables. */
+  PRINTF("Starting reassembly\n");
+  memcpy(FBUF, UIP_IP_BUF, uip_ext_len + UIP_IPH_LEN);
+  /* temporary in case we do not receive the fragment with offset 0 first */
+  etimer_set(&ctx->timer, UIP_REASS_MAXAGE*CLOCK_SECOND);
+  ctx->flags = UIP_REASS_FLAG_INUSE;
+  ctx->id = UIP_FRAG_BUF->id;
+  /* Clear the bitmap. */
+  memset(ctx->bitmap, 0, sizeof(ctx->bitmap));
+  return ctx;
+}
+/*---------------------------------------------------------------------------*/
+static void
+uip_reass_free(struct uip_reass_ctx *ctx)
+{
+  ctx->flags = 0;
+  etimer_stop(&ctx->timer);
+}
+/*---------------------------------------------------------------------------*/
 static u16_t
 uip_reass(void)
 {
+  struct uip_reass_ctx *ctx;
   u16_t offset=0;
   u16_t len;
   u16_t i;
-  
-  /* If ip_reasstmr is zero, no packet is present in the buffer */
-  /* We first write the unfragmentable part of IP header into the reassembly
-     buffer. The reset the other reassembly variables. */
-  if(uip_reass_on == 0) {
-    PRINTF("Starting reassembly\n");
+
+  uip_reass_errmsg = 0;
+  ctx = uip_reass_lookup();
+  if(ctx == NULL) {
+    return 0;
+  }
+
+  len = uip_len - uip_ext_len - UIP_IPH_LEN - UIP_FRAGH_LEN;
+  offset = (uip_ntohs(UIP_FRAG_BUF->offsetresmore) & 0xfff8);
+  /* in byte, originaly in multiple of 8 bytes*/
+  PRINTF("len %d\n", len);
+  PRINTF("offset %d\n", offset);
+  if(offset == 0){
+    ctx->flags |= UIP_REASS_FLAG_FIRSTFRAG;
+    /*
+     * The Next Header field of the last header of the Unfragmentable
+     * Part is obtained from the Next Header field of the first
+     * fragment's Fragment header.
+     */
+    *uip_next_hdr = UIP_FRAG_BUF->next;
     memcpy(FBUF, UIP_IP_BUF, uip_ext_len + UIP_IPH_LEN);
-    /* temporary in case we do not receive the fragment with offset 0 first */
-    etimer_set(&uip_reass_timer, UIP_REASS_MAXAGE*CLOCK_SECOND);
-    uip_reass_on = 1;
-    uip_reassflags = 0;
-    uip_id = UIP_FRAG_BUF->id;
-    /* Clear the bitmap. */
-    memset(uip_reassbitmap, 0, sizeof(uip_reassbitmap));
+    PRINTF("src ");
+    PRINT6ADDR(&FBUF->srcipaddr);
+    PRINTF("dest ");
+    PRINT6ADDR(&FBUF->destipaddr);
+    PRINTF("next %d\n", UIP_IP_BUF->proto);
   }
-  /*
-   * Check if the incoming fragment matches the one currently present
-   * in the reasembly buffer. If so, we proceed with copying the fragment
-   * into the buffer.
-   */
-  if(uip_ipaddr_cmp(&FBUF->srcipaddr, &UIP_IP_BUF->srcipaddr) &&
-     uip_ipaddr_cmp(&FBUF->destipaddr, &UIP_IP_BUF->destipaddr) &&
-     UIP_FRAG_BUF->id == uip_id) {
-    len = uip_len - uip_ext_len - UIP_IPH_LEN - UIP_FRAGH_LEN;
-    offset = (uip_ntohs(UIP_FRAG_BUF->offsetresmore) & 0xfff8);
-    /* in byte, originaly in multiple of 8 bytes*/
-    PRINTF("len %d\n", len);
-    PRINTF("offset %d\n", offset);
-    if(offset == 0){
-      uip_reassflags |= UIP_REASS_FLAG_FIRSTFRAG;
-      /*
-       * The Next Header field of the last header of the Unfragmentable
-       * Part is obtained from the Next Header field of the first
-       * fragment's Fragment header.
-       */
-      *uip_next_hdr = UIP_FRAG_BUF->next;
-      memcpy(FBUF, UIP_IP_BUF, uip_ext_len + UIP_IPH_LEN);
-      PRINTF("src ");
-      PRINT6ADDR(&FBUF->srcipaddr);
-      PRINTF("dest ");
-      PRINT6ADDR(&FBUF->destipaddr);
-      PRINTF("next %d\n", UIP_IP_BUF->proto);
-      
+
+  /* If the offset or the offset + fragment length overflows the
+     reassembly buffer, we discard the entire packet. */
+  if(offset > UIP_REASS_BUFSIZE ||
+     offset + len > UIP_REASS_BUFSIZE - UIP_IPH_LEN - uip_ext_len) {
+    uip_reass_free(ctx);
+    return 0;
+  }
+
+  /* If this fragment has the More Fragments flag set to zero, it is the
+     last fragment*/
+  if((uip_ntohs(UIP_FRAG_BUF->offsetresmore) & IP_MF) == 0) {
+    ctx->flags |= UIP_REASS_FLAG_LASTFRAG;
+    /*calculate the size of the entire packet*/
+    ctx->len = offset + len;
+    PRINTF("LAST FRAGMENT reasslen %d\n", ctx->len);
+  } else {
+    /* If len is not a multiple of 8 octets and the M flag of that fragment
+       is 1, then that fragment must be discarded and an ICMP Parameter
+       Problem, Code 0, message should be sent to the source of the fragment,
+       pointing to the Payload Length field of the fragment packet. */
+    if(len % 8 != 0){
+      uip_icmp6_error_output(ICMP6_PARAM_PROB, ICMP6_PARAMPROB_HEADER, 4);
+      uip_reass_errmsg = 1;
+      /* not clear if we should interrupt reassembly, but it seems so from
+         the conformance tests */
+      uip_reass_free(ctx);
+      return uip_len;
     }
-    
-    /* If the offset or the offset + fragment length overflows the
-       reassembly buffer, we discard the entire packet. */
-    if(offset > UIP_REASS_BUFSIZE ||
-       offset + len > UIP_REASS_BUFSIZE) {
-      uip_reass_on = 0;
-      etimer_stop(&uip_reass_timer);
-      return 0;
+  }
+
+  /* Copy the fragment into the reassembly buffer, at the right
+     offset. */
+  memcpy((uint8_t *)FBUF + UIP_IPH_LEN + uip_ext_len + offset,
+         (uint8_t *)UIP_FRAG_BUF + UIP_FRAGH_LEN, len);
+
+  /* Update the bitmap. */
+  if(offset >> 6 == (offset + len) >> 6) {
+    ctx->bitmap[offset >> 6] |=
+      bitmap_bits[(offset >> 3) & 7] &
+      ~bitmap_bits[((offset + len) >> 3)  & 7];
+  } else {
+    /* If the two endpoints are in different bytes, we update the
+       bytes in the endpoints and fill the stuff inbetween with
+       0xff. */
+    ctx->bitmap[offset >> 6] |= bitmap_bits[(offset >> 3) & 7];
+
+    for(i = (1 + (offset >> 6)); i < ((offset + len) >> 6); ++i) {
+      ctx->bitmap[i] = 0xff;
     }
+    ctx->bitmap[(offset + len) >> 6] |=
+      ~bitmap_bits[((offset + len) >> 3) & 7];
+  }
 
-    /* If this fragment has the More Fragments flag set to zero, it is the
-       last fragment*/
-    if((uip_ntohs(UIP_FRAG_BUF->offsetresmore) & IP_MF) == 0) {
-      uip_reassflags |= UIP_REASS_FLAG_LASTFRAG;
-      /*calculate the size of the entire packet*/
-      uip_reasslen = offset + len;
-      PRINTF("LAST FRAGMENT reasslen %d\n", uip_reasslen);
-    } else {
-      /* If len is not a multiple of 8 octets and the M flag of that fragment
-         is 1, then that fragment must be discarded and an ICMP Parameter
-         Problem, Code 0, message should be sent to the source of the fragment,
-         pointing to the Payload Length field of the fragment packet. */
-      if(len % 8 != 0){
-        uip_icmp6_error_output(ICMP6_PARAM_PROB, ICMP6_PARAMPROB_HEADER, 4);
-        uip_reassflags |= UIP_REASS_FLAG_ERROR_MSG;
-        /* not clear if we should interrupt reassembly, but it seems so from
-           the conformance tests */
-        uip_reass_on = 0;
-        etimer_stop(&uip_reass_timer);
-        return uip_len;
+  /* Finally, we check if we have a full packet in the buffer. We do
+     this by checking if we have the last fragment and if all bits
+     in the bitmap are set. */
+
+  if(ctx->flags & UIP_REASS_FLAG_LASTFRAG) {
+    /* Check all bytes up to and including all but the last byte in
+       the bitmap. */
+    for(i = 0; i < (ctx->len >> 6); ++i) {
+      if(ctx->bitmap[i] != 0xff) {
+        return 0;
       }
     }
-    
-    /* Copy the fragment into the reassembly buffer, at the right
-       offset. */
-    memcpy((uint8_t *)FBUF + UIP_IPH_LEN + uip_ext_len + offset,
-           (uint8_t *)UIP_FRAG_BUF + UIP_FRAGH_LEN, len);
-    
-    /* Update the bitmap. */
-    if(offset >> 6 == (offset + len) >> 6) {
-      uip_reassbitmap[offset >> 6] |=
-        bitmap_bits[(offset >> 3) & 7] &
-        ~bitmap_bits[((offset + len) >> 3)  & 7];
-    } else {
-      /* If the two endpoints are in different bytes, we update the
-         bytes in the endpoints and fill the stuff inbetween with
-         0xff. */
-      uip_reassbitmap[offset >> 6] |= bitmap_bits[(offset >> 3) & 7];
- 
-      for(i = (1 + (offset >> 6)); i < ((offset + len) >> 6); ++i) {
-        uip_reassbitmap[i] = 0xff;
-      }
-      uip_reassbitmap[(offset + len) >> 6] |=
-        ~bitmap_bits[((offset + len) >> 3) & 7];
+    /* Check the last byte in the bitmap. It should contain just the
+       right amount of bits. */
+    if(ctx->bitmap[ctx->len >> 6] !=
+       (u8_t)~bitmap_bits[(ctx->len >> 3) & 7]) {
+      return 0;
     }
-  
-    /* Finally, we check if we have a full packet in the buffer. We do
-       this by checking if we have the last fragment and if all bits
-       in the bitmap are set. */
-    
-    if(uip_reassflags & UIP_REASS_FLAG_LASTFRAG) {
-      /* Check all bytes up to and including all but the last byte in
-         the bitmap. */
-      for(i = 0; i < (uip_reasslen >> 6); ++i) {
-        if(uip_reassbitmap[i] != 0xff) {
-          return 0;
-        }
-      }
-      /* Check the last byte in the bitmap. It should contain just the
-         right amount of bits. */
-      if(uip_reassbitmap[uip_reasslen >> 6] !=
-         (u8_t)~bitmap_bits[(uip_reasslen >> 3) & 7]) {
-        return 0;
-      }
 
-     /* If we have come this far, we have a full packet in the
-         buffer, so we copy it to uip_buf. We also reset the timer. */
-      uip_reass_on = 0;
-      etimer_stop(&uip_reass_timer);
-
-      uip_reasslen += UIP_IPH_LEN + uip_ext_len;
-      memcpy(UIP_IP_BUF, FBUF, uip_reasslen);
-      UIP_IP_BUF->len[0] = ((uip_reasslen - UIP_IPH_LEN) >> 8);
-      UIP_IP_BUF->len[1] = ((uip_reasslen - UIP_IPH_LEN) & 0xff);
-      PRINTF("REASSEMBLED PAQUET %d (%d)\n", uip_reasslen,
-             (UIP_IP_BUF->len[0] << 8) | UIP_IP_BUF->len[1]);
-   
-      return uip_reasslen;
-      
-    }
-  } else {
-    PRINTF("Already reassembling another paquet\n");
+    /* If we have come this far, we have a full packet in the
+       buffer, so we copy it to uip_buf. We also reset the timer. */
+    uip_reass_free(ctx);
+    UIP_STAT(++uip_reass_stats.reassembled);
+
+    len = ctx->len + UIP_IPH_LEN + uip_ext_len;
+    memcpy(UIP_IP_BUF, FBUF, len);
+    UIP_IP_BUF->len[0] = ((len - UIP_IPH_LEN) >> 8);
+    UIP_IP_BUF->len[1] = ((len - UIP_IPH_LEN) & 0xff);
+    PRINTF("REASSEMBLED PAQUET %d (%d)\n", len,
+           (UIP_IP_BUF->len[0] << 8) | UIP_IP_BUF->len[1]);
+
+    return len;
   }
   return 0;
 }
-
-void
-uip_reass_over(void)
+/*---------------------------------------------------------------------------*/
+u8_t
+uip_reass_over(void *timer)
 {
-   /* to late, we abandon the reassembly of the packet */
+  struct uip_reass_ctx *ctx;
+
+  for(ctx = uip_reass_ctxs;
+      ctx < &uip_reass_ctxs[UIP_CONF_IPV6_REASS_CONTEXTS]; ctx++) {
+    if(timer == &ctx->timer && (ctx->flags & UIP_REASS_FLAG_INUSE) &&
+       etimer_expired(&ctx->timer)) {
+      break;
+    }
+  }
+  if(ctx == &uip_reass_ctxs[UIP_CONF_IPV6_REASS_CONTEXTS]) {
+    return 0;
+  }
 
-  uip_reass_on = 0;
-  etimer_stop(&uip_reass_timer);
+  /* to late, we abandon the reassembly of the packet */
+  UIP_STAT(++uip_reass_stats.timedout);
 
-  if(uip_reassflags & UIP_REASS_FLAG_FIRSTFRAG){
+  if(ctx->flags & UIP_REASS_FLAG_FIRSTFRAG){
     PRINTF("FRAG INTERRUPTED TOO LATE\n");
     /* If the first fragment has been received, an ICMP Time Exceeded
        -- Fragment Reassembly Time Exceeded message should be sent to the
@@ -783,6 +1043,8 @@ uip_reass_over(void)
     UIP_STAT(++uip_stat.ip.sent);
     uip_flags = 0;
   }
+  uip_reass_free(ctx);
+  return 1;
 }
 
 #endif /* UIP_CONF_IPV6_REASSEMBLY */
@@ -884,7 +1146,11 @@ uip_process(u8_t flag)
   if(flag == UIP_POLL_REQUEST) {
 #if UIP_TCP
     if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
-       !uip_outstanding(uip_connr)) {
+       (!uip_outstanding(uip_connr)
+#if UIP_TCP_SNDWND
+        || uip_sndwnd_room(uip_connr) > 0
+#endif /* UIP_TCP_SNDWND */
+        )) {
       uip_flags = UIP_POLL;
       UIP_APPCALL();
       goto appsend;
@@ -938,6 +1204,9 @@ uip_process(u8_t flag)
                uip_connr->tcpstateflags == UIP_SYN_RCVD) &&
               uip_connr->nrtx == UIP_MAXSYNRTX)) {
             uip_connr->tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_SNDWND
+            uip_sndwnd_flush(uip_connr);
+#endif /* UIP_TCP_SNDWND */
                   
             /*
              * We call UIP_APPCALL() with uip_flags set to
@@ -980,6 +1249,12 @@ uip_process(u8_t flag)
 #endif /* UIP_ACTIVE_OPEN */
                      
             case UIP_ESTABLISHED:
+#if UIP_TCP_SNDWND
+              /* With a send window, we have the data ourselves. */
+              if(uip_connr->sndq != NULL) {
+                goto tcp_send_oldest;
+              }
+#endif /* UIP_TCP_SNDWND */
               /*
                * In the ESTABLISHED state, we call upon the application
                * to do the actual retransmit after which we jump into
@@ -997,6 +1272,15 @@ uip_process(u8_t flag)
               goto tcp_send_finack;
           }
         }
+#if UIP_TCP_SNDWND
+        /* The application may send more while data is in flight. */
+        if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
+           uip_sndwnd_room(uip_connr) > 0) {
+          uip_flags = UIP_POLL;
+          UIP_APPCALL();
+          goto appsend;
+        }
+#endif /* UIP_TCP_SNDWND */
       } else if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
         /*
          * If there was no need for a retransmission, we poll the
@@ -1007,6 +1291,14 @@ uip_process(u8_t flag)
         goto appsend;
       }
     }
+#if UIP_TCP_DELACK
+    /* Send the ACK for data that was received since the last
+       timer, if nothing else has carried it. */
+    if(uip_connr->delack > 0 &&
+       (uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
+      goto tcp_send_ack;
+    }
+#endif /* UIP_TCP_DELACK */
     goto drop;
 #endif /* UIP_TCP */
   }
@@ -1249,7 +1541,7 @@ uip_process(u8_t flag)
         if(uip_len == 0) {
           goto drop;
         }
-        if(uip_reassflags & UIP_REASS_FLAG_ERROR_MSG){
+        if(uip_reass_errmsg){
           /* we are not done with reassembly, this is an error message */
           goto send;
         }
@@ -1397,22 +1689,26 @@ uip_process(u8_t flag)
   }
 
   /* Demultiplex this UDP packet between the UDP "connections". */
+#if UIP_DEMUX_HASH
+  /* First try the connection that the last packet with the same ports
+     and source address went to. */
+  demux = demux_hash(UIP_UDP_BUF->destport, UIP_UDP_BUF->srcport,
+                     &UIP_IP_BUF->srcipaddr);
+  uip_udp_conn = udp_demux[demux];
+  if(uip_udp_conn != NULL && udp_conn_specified(uip_udp_conn) &&
+     udp_conn_match(uip_udp_conn)) {
+    goto udp_found;
+  }
+#endif /* UIP_DEMUX_HASH */
   for(uip_udp_conn = &uip_udp_conns[0];
       uip_udp_conn < &uip_udp_conns[UIP_UDP_CONNS];
       ++uip_udp_conn) {
-    /* If the local UDP port is non-zero, the connection is considered
-       to be used. If so, the local port number is checked against the
-       destination port number in the received packet. If the two port
-       numbers match, the remote port number is checked if the
-       connection is bound to a remote port. Finally, if the
-       connection is bound to a remote IP address, the source IP
-       address of the packet is checked. */
-    if(uip_udp_conn->lport != 0 &&
-       UIP_UDP_BUF->destport == uip_udp_conn->lport &&
-       (uip_udp_conn->rport == 0 ||
-        UIP_UDP_BUF->srcport == uip_udp_conn->rport) &&
-       (uip_is_addr_unspecified(&uip_udp_conn->ripaddr) ||
-        uip_ipaddr_cmp(&UIP_IP_BUF->srcipaddr, &uip_udp_conn->ripaddr))) {
+    if(udp_conn_match(uip_udp_conn)) {
+#if UIP_DEMUX_HASH
+      if(udp_conn_specified(uip_udp_conn)) {
+        udp_demux[demux] = uip_udp_conn;
+      }
+#endif /* UIP_DEMUX_HASH */
       goto udp_found;
     }
   }
@@ -1497,12 +1793,20 @@ uip_process(u8_t flag)
 
   /* Demultiplex this segment. */
   /* First check any active connections. */
+#if UIP_DEMUX_HASH
+  demux = demux_hash(UIP_TCP_BUF->destport, UIP_TCP_BUF->srcport,
+                     &UIP_IP_BUF->srcipaddr);
+  uip_connr = tcp_demux[demux];
+  if(uip_connr != NULL && tcp_conn_match(uip_connr)) {
+    goto found;
+  }
+#endif /* UIP_DEMUX_HASH */
   for(uip_connr = &uip_conns[0]; uip_connr <= &uip_conns[UIP_CONNS - 1];
       ++uip_connr) {
-    if(uip_connr->tcpstateflags != UIP_CLOSED &&
-       UIP_TCP_BUF->destport == uip_connr->lport &&
-       UIP_TCP_BUF->srcport == uip_connr->rport &&
-       uip_ipaddr_cmp(&UIP_IP_BUF->srcipaddr, &uip_connr->ripaddr)) {
+    if(tcp_conn_match(uip_connr)) {
+#if UIP_DEMUX_HASH
+      tcp_demux[demux] = uip_connr;
+#endif /* UIP_DEMUX_HASH */
       goto found;
     }
   }
@@ -1628,6 +1932,14 @@ uip_process(u8_t flag)
   uip_connr->snd_nxt[2] = iss[2];
   uip_connr->snd_nxt[3] = iss[3];
   uip_connr->len = 1;
+#if UIP_TCP_SNDWND
+  uip_sndwnd_flush(uip_connr);
+  uip_connr->sndwnd = 0;
+  uip_connr->snd_wnd = 0;
+#endif /* UIP_TCP_SNDWND */
+#if UIP_TCP_DELACK
+  uip_connr->delack = 0;
+#endif /* UIP_TCP_DELACK */
 
   /* rcv_nxt should be the seqno from the incoming packet + 1. */
   uip_connr->rcv_nxt[3] = UIP_TCP_BUF->seqno[3];
@@ -1702,6 +2014,9 @@ uip_process(u8_t flag)
      before we accept the reset. */
   if(UIP_TCP_BUF->flags & TCP_RST) {
     uip_connr->tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_SNDWND
+    uip_sndwnd_flush(uip_connr);
+#endif /* UIP_TCP_SNDWND */
     UIP_LOG("tcp: got reset, aborting connection.");
     uip_flags = UIP_ABORT;
     UIP_APPCALL();
@@ -1741,6 +2056,36 @@ uip_process(u8_t flag)
      data. If so, we update the sequence number, reset the length of
      the outstanding data, calculate RTT estimations, and reset the
      retransmission timer. */
+#if UIP_TCP_SNDWND
+  /* With a send window, the ACK may cover only part of the data in
+     flight. An ACK that covers nothing new, carries no data and does
+     not change the window is a duplicate; after a few of them, the
+     oldest segment was probably lost and we send it again at once. */
+  if(uip_connr->sndq != NULL) {
+    if(UIP_TCP_BUF->flags & TCP_ACK) {
+      if(uip_sndwnd_ack(uip_connr, UIP_TCP_BUF->ackno, &timed) > 0) {
+        uip_connr->dupacks = 0;
+        uip_connr->nrtx = 0;
+        if(timed) {
+          goto rtt_estimate;
+        }
+        goto ackdata;
+      }
+      if(uip_len == 0 &&
+         (UIP_TCP_BUF->flags & (TCP_SYN | TCP_FIN)) == 0 &&
+         UIP_TCP_BUF->wnd[0] == (uip_connr->snd_wnd >> 8) &&
+         UIP_TCP_BUF->wnd[1] == (uip_connr->snd_wnd & 0xff) &&
+         UIP_TCP_BUF->ackno[0] == uip_connr->snd_nxt[0] &&
+         UIP_TCP_BUF->ackno[1] == uip_connr->snd_nxt[1] &&
+         UIP_TCP_BUF->ackno[2] == uip_connr->snd_nxt[2] &&
+         UIP_TCP_BUF->ackno[3] == uip_connr->snd_nxt[3] &&
+         ++uip_connr->dupacks == UIP_SNDWND_DUPACKS) {
+        UIP_STAT(++uip_stat.tcp.rexmit);
+        goto tcp_send_oldest;
+      }
+    }
+  } else
+#endif /* UIP_TCP_SNDWND */
   if((UIP_TCP_BUF->flags & TCP_ACK) && uip_outstanding(uip_connr)) {
     uip_add32(uip_connr->snd_nxt, uip_connr->len);
 
@@ -1753,8 +2098,14 @@ uip_process(u8_t flag)
       uip_connr->snd_nxt[1] = uip_acc32[1];
       uip_connr->snd_nxt[2] = uip_acc32[2];
       uip_connr->snd_nxt[3] = uip_acc32[3];
+
+      /* Reset length of outstanding data. */
+      uip_connr->len = 0;
    
       /* Do RTT estimation, unless we have done retransmissions. */
+#if UIP_TCP_SNDWND
+    rtt_estimate:
+#endif /* UIP_TCP_SNDWND */
       if(uip_connr->nrtx == 0) {
         signed char m;
         m = uip_connr->rto - uip_connr->timer;
@@ -1769,17 +2120,27 @@ uip_process(u8_t flag)
         uip_connr->rto = (uip_connr->sa >> 3) + uip_connr->sv;
 
       }
+#if UIP_TCP_SNDWND
+    ackdata:
+#endif /* UIP_TCP_SNDWND */
       /* Set the acknowledged flag. */
       uip_flags = UIP_ACKDATA;
       /* Reset the retransmission timer. */
       uip_connr->timer = uip_connr->rto;
-
-      /* Reset length of outstanding data. */
-      uip_connr->len = 0;
     }
     
   }
 
+#if UIP_TCP_SNDWND
+  /* Remember the window the peer advertises, also in the segment that
+     completes the handshake, so that the send window can be filled
+     right away. */
+  if(UIP_TCP_BUF->flags & TCP_ACK) {
+    uip_connr->snd_wnd = ((u16_t)UIP_TCP_BUF->wnd[0] << 8) +
+      (u16_t)UIP_TCP_BUF->wnd[1];
+  }
+#endif /* UIP_TCP_SNDWND */
+
   /* Do different things depending on in what state the connection is. */
   switch(uip_connr->tcpstateflags & UIP_TS_MASK) {
     /* CLOSED and LISTEN are not handled here. CLOSE_WAIT is not
@@ -1975,10 +2336,30 @@ uip_process(u8_t flag)
         if(uip_flags & UIP_ABORT) {
           uip_slen = 0;
           uip_connr->tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_SNDWND
+          uip_sndwnd_flush(uip_connr);
+#endif /* UIP_TCP_SNDWND */
           UIP_TCP_BUF->flags = TCP_RST | TCP_ACK;
           goto tcp_send_nodata;
         }
 
+#if UIP_TCP_SNDWND
+        /* Our FIN must come after the data in flight, so a close
+           waits until all of it has been acknowledged. */
+        if(uip_connr->sndwnd) {
+          if(uip_flags & UIP_CLOSE) {
+            uip_connr->sndwnd |= UIP_SNDWND_CLOSE;
+          }
+          if(uip_connr->sndwnd & UIP_SNDWND_CLOSE) {
+            uip_slen = 0;
+            uip_flags &= ~UIP_CLOSE;
+            if(!uip_outstanding(uip_connr)) {
+              uip_flags |= UIP_CLOSE;
+            }
+          }
+        }
+#endif /* UIP_TCP_SNDWND */
+
         if(uip_flags & UIP_CLOSE) {
           uip_slen = 0;
           uip_connr->len = 1;
@@ -1989,6 +2370,22 @@ uip_process(u8_t flag)
         }
 
         /* If uip_slen > 0, the application has data to be sent. */
+#if UIP_TCP_SNDWND
+        if(uip_slen > 0 && uip_connr->sndwnd) {
+          /* With a send window, the data goes after the data in
+             flight, if there is room for it. */
+          tmp16 = uip_sndwnd_room(uip_connr);
+          if(uip_slen > tmp16) {
+            uip_slen = tmp16;
+          }
+          sndoff = uip_connr->len;
+          if(uip_slen == 0 ||
+             !uip_sndwnd_push(uip_connr, uip_sappdata, uip_slen)) {
+            uip_slen = 0;
+            sndoff = 0;
+          }
+        } else
+#endif /* UIP_TCP_SNDWND */
         if(uip_slen > 0) {
 
           /* If the connection has acknowledged data, the contents of
@@ -2020,6 +2417,11 @@ uip_process(u8_t flag)
             uip_slen = uip_connr->len;
           }
         }
+#if UIP_TCP_SNDWND
+        /* With data in flight, the retransmission count is that of
+           the oldest segment. */
+        if(uip_connr->sndq == NULL)
+#endif /* UIP_TCP_SNDWND */
         uip_connr->nrtx = 0;
       apprexmit:
         uip_appdata = uip_sappdata;
@@ -2029,6 +2431,12 @@ uip_process(u8_t flag)
         if(uip_slen > 0 && uip_connr->len > 0) {
           /* Add the length of the IP and TCP headers. */
           uip_len = uip_connr->len + UIP_TCPIP_HLEN;
+#if UIP_TCP_SNDWND
+          if(uip_connr->sndwnd) {
+            /* Only the new data. */
+            uip_len = uip_slen + UIP_TCPIP_HLEN;
+          }
+#endif /* UIP_TCP_SNDWND */
           /* We always set the ACK flag in response packets. */
           UIP_TCP_BUF->flags = TCP_ACK | TCP_PSH;
           /* Send the packet. */
@@ -2037,10 +2445,23 @@ uip_process(u8_t flag)
         /* If there is no data to send, just send out a pure ACK if
            there is newdata. */
         if(uip_flags & UIP_NEWDATA) {
+#if UIP_TCP_DELACK
+          /* Hold the ACK back until enough segments have arrived or
+             the periodic timer fires. */
+          if(++uip_connr->delack < UIP_TCP_DELACK) {
+            goto drop;
+          }
+#endif /* UIP_TCP_DELACK */
           uip_len = UIP_TCPIP_HLEN;
           UIP_TCP_BUF->flags = TCP_ACK;
           goto tcp_send_noopts;
         }
+#if UIP_TCP_DELACK
+        /* The periodic timer sends an ACK that was held back. */
+        if(flag == UIP_TIMER && uip_connr->delack > 0) {
+          goto tcp_send_ack;
+        }
+#endif /* UIP_TCP_DELACK */
       }
       goto drop;
     case UIP_LAST_ACK:
@@ -2110,6 +2531,14 @@ uip_process(u8_t flag)
   }
   goto drop;
   
+#if UIP_TCP_SNDWND
+  /* Send the oldest unacknowledged segment of the send window again. */
+ tcp_send_oldest:
+  uip_len = uip_sndwnd_oldest(uip_connr, uip_sappdata) + UIP_TCPIP_HLEN;
+  UIP_TCP_BUF->flags = TCP_ACK | TCP_PSH;
+  goto tcp_send_noopts;
+#endif /* UIP_TCP_SNDWND */
+
   /* We jump here when we are ready to send the packet, and just want
      to set the appropriate TCP sequence numbers in the TCP header. */
  tcp_send_ack:
@@ -2137,6 +2566,18 @@ uip_process(u8_t flag)
   UIP_TCP_BUF->seqno[1] = uip_connr->snd_nxt[1];
   UIP_TCP_BUF->seqno[2] = uip_connr->snd_nxt[2];
   UIP_TCP_BUF->seqno[3] = uip_connr->snd_nxt[3];
+#if UIP_TCP_DELACK
+  /* Every segment we send acknowledges the data received so far. */
+  uip_connr->delack = 0;
+#endif /* UIP_TCP_DELACK */
+#if UIP_TCP_SNDWND
+  if(sndoff > 0) {
+    /* New data is sent after the data already in flight. */
+    uip_add32(UIP_TCP_BUF->seqno, sndoff);
+    memcpy(UIP_TCP_BUF->seqno, uip_acc32, 4);
+    sndoff = 0;
+  }
+#endif /* UIP_TCP_SNDWND */
 
   UIP_IP_BUF->proto = UIP_PROTO_TCP;
   
@@ -204,6 +204,12 @@
 #define UIP_CONF_IPV6_REASSEMBLY      0
 #endif
 
+#ifndef UIP_CONF_IPV6_REASS_CONTEXTS
+/** Number of IPv6 datagrams reassembled at the same time, each taking a
+    buffer of UIP_BUFSIZE bytes (default: 1) */
+#define UIP_CONF_IPV6_REASS_CONTEXTS  1
+#endif
+
 #ifndef UIP_CONF_NETIF_MAX_ADDRESSES
 /** Default number of IPv6 addresses associated to the node's interface */
 #define UIP_CONF_NETIF_MAX_ADDRESSES  3
@@ -272,6 +278,23 @@
 #define UIP_UDP_CONNS    10
 #endif /* UIP_CONF_UDP_CONNS */
 
+/**
+ * The number of datagram buffers shared by the UDP receive queues.
+ *
+ * With a non-zero value, a UDP connection can be given a receive
+ * queue with uip_udp_queue_attach(). Its datagrams are then kept
+ * until the application takes them out, instead of being lost if the
+ * application is not ready for them when they arrive. The default is
+ * 0, which leaves out the receive queues.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_UDP_QUEUE
+#define UIP_UDP_QUEUE (UIP_CONF_UDP_QUEUE)
+#else /* UIP_CONF_UDP_QUEUE */
+#define UIP_UDP_QUEUE    0
+#endif /* UIP_CONF_UDP_QUEUE */
+
 /**
  * The name of the function that should be called when UDP datagrams arrive.
  *
@@ -415,6 +438,39 @@
 #define UIP_TIME_WAIT_TIMEOUT UIP_CONF_WAIT_TIMEOUT
 #endif
 
+/**
+ * The number of segment buffers, of UIP_TCP_MSS bytes each, that
+ * uIP keeps sent TCP data in until it is acknowledged. The buffers
+ * are shared by all connections.
+ *
+ * With a non-zero value, a connection that calls
+ * uip_sndwnd_enable() may have several segments in flight, and uIP
+ * retransmits them by itself. The default is 0: each connection has
+ * a single segment in flight, which the application retransmits
+ * when uip_rexmit() is set.
+ */
+#ifdef UIP_CONF_TCP_SNDWND
+#define UIP_TCP_SNDWND (UIP_CONF_TCP_SNDWND)
+#else
+#define UIP_TCP_SNDWND 0
+#endif
+
+/**
+ * Delayed acknowledgements (RFC 1122): received TCP data is
+ * acknowledged after this many segments, or at the latest by the
+ * next periodic timer, unless the application replies with data
+ * that carries the ACK. RFC 1122 recommends 2.
+ *
+ * The default is 0, which acknowledges every segment at once. A
+ * sender that waits for each segment to be acknowledged, as uIP
+ * itself does, is slowed down to one segment per periodic timer.
+ */
+#ifdef UIP_CONF_TCP_DELACK
+#define UIP_TCP_DELACK (UIP_CONF_TCP_DELACK)
+#else
+#define UIP_TCP_DELACK 0
+#endif
+
 /** @} */
 /*------------------------------------------------------------------------------*/
 /**
@@ -495,6 +551,26 @@
 #define SICSLOWPAN_CONF_FRAG  0
 #endif
 
+/**
+ * How many fragmented packets we reassemble at the same time, from
+ * different senders or with different datagram tags. Each takes a
+ * buffer of UIP_BUFSIZE bytes (default: 1)
+ */
+#ifndef SICSLOWPAN_CONF_REASS_CONTEXTS
+#define SICSLOWPAN_CONF_REASS_CONTEXTS 1
+#endif
+
+/**
+ * When fragmenting, build all fragments of a datagram before sending
+ * the first one, and hand this many at a time to the MAC, stopping
+ * when one fails (default: 0, each fragment is sent as it is built).
+ * QUEUEBUF_CONF_NUM must be large enough to hold all fragments of
+ * the largest datagram.
+ */
+#ifndef SICSLOWPAN_CONF_FRAG_PIPELINE
+#define SICSLOWPAN_CONF_FRAG_PIPELINE 0
+#endif
+
 /** @} */
 
 /*------------------------------------------------------------------------------*/
@@ -519,6 +595,50 @@
 #define UIP_BUFSIZE (UIP_CONF_BUFFER_SIZE)
 #endif /* UIP_CONF_BUFFER_SIZE */
 
+/**
+ * The number of packet buffers in the uIP buffer pool (IPv6 only).
+ *
+ * When non-zero, uip_buf is one buffer out of a pool of this many
+ * instead of a single static array, and packets waiting for address
+ * resolution in uip-packetqueue keep the buffer they were sent from
+ * instead of being copied. One buffer is always in use as uip_buf.
+ * The 6lowpan layer reassembles fragmented packets into a buffer of
+ * the pool, which becomes uip_buf once the packet is complete, so
+ * each reassembly in progress holds one buffer. The other drivers in
+ * the tree still read into and send from uip_buf.
+ *
+ * \hideinitializer
+ */
+#if UIP_CONF_IPV6 && defined(UIP_CONF_BUFFER_POOL)
+#define UIP_BUFFER_POOL (UIP_CONF_BUFFER_POOL)
+#else
+#define UIP_BUFFER_POOL 0
+#endif
+
+#if UIP_BUFFER_POOL && defined(UIP_CONF_EXTERNAL_BUFFER)
+#error "UIP_CONF_BUFFER_POOL cannot be used with UIP_CONF_EXTERNAL_BUFFER"
+#endif
+
+/**
+ * The number of slots in the hash tables that find the TCP and UDP
+ * connection of an incoming packet.
+ *
+ * When non-zero, each slot remembers the connection that last
+ * received a packet with the same ports and source address, so that
+ * uIP does not have to search all connections for the next one. UDP
+ * connections are only remembered when they are bound to a remote
+ * port and address; packets for the others are still found by the
+ * search. A power of two is best. The default is 0, which searches
+ * the connections for every packet.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_DEMUX_HASH
+#define UIP_DEMUX_HASH (UIP_CONF_DEMUX_HASH)
+#else
+#define UIP_DEMUX_HASH 0
+#endif
+
 
 /**
  * Determines if statistics support should be compiled in.
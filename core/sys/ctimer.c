@@ -61,6 +61,169 @@ static char initialized;
 
 /*---------------------------------------------------------------------------*/
 PROCESS(ctimer_process, "Ctimer process");
+#if CTIMER_CONF_BATCH
+/*
+ * In batch mode, the pending callback timers are kept on ctimer_list
+ * in expiration order and share a single etimer that is set to the
+ * expiration time of the first timer on the list. The etimer embedded
+ * in each ctimer only holds its timer and pending flag: p points to
+ * ctimer_process while the callback timer is pending.
+ */
+static struct etimer batch_timer;
+
+#define EXPIRATION(c) ((c)->etimer.timer.start + (c)->etimer.timer.interval)
+/*---------------------------------------------------------------------------*/
+/* Wrap safe check if callback timer a expires before b. */
+static int
+expires_before(struct ctimer *a, struct ctimer *b)
+{
+  return (clock_time_t)(EXPIRATION(a) - EXPIRATION(b)) >
+    (clock_time_t)(~(clock_time_t)0 >> 1);
+}
+/*---------------------------------------------------------------------------*/
+/* Set the shared etimer to the expiration of the first timer. */
+static void
+schedule(void)
+{
+  struct ctimer *c;
+  clock_time_t interval;
+
+  if(!initialized) {
+    return;
+  }
+
+  c = list_head(ctimer_list);
+  if(c == NULL) {
+    etimer_stop(&batch_timer);
+    return;
+  }
+
+  interval = 0;
+  if(!timer_expired(&c->etimer.timer)) {
+    interval = EXPIRATION(c) - clock_time();
+  }
+  PROCESS_CONTEXT_BEGIN(&ctimer_process);
+  etimer_set(&batch_timer, interval);
+  PROCESS_CONTEXT_END(&ctimer_process);
+}
+/*---------------------------------------------------------------------------*/
+static void
+add_timer(struct ctimer *c)
+{
+  struct ctimer *prev, *t;
+
+  list_remove(ctimer_list, c);
+
+  /* Insert after all timers that do not expire later than c, so that
+     timers with equal expiration times run in the order they were
+     set. */
+  prev = NULL;
+  for(t = list_head(ctimer_list);
+      t != NULL && !expires_before(c, t);
+      t = t->next) {
+    prev = t;
+  }
+  list_insert(ctimer_list, prev, c);
+  c->etimer.p = &ctimer_process;
+
+  /* The shared etimer only needs to move if c is the new first
+     timer. If the first timer was removed or set later instead, the
+     etimer fires early and is set again then. */
+  if(prev == NULL) {
+    schedule();
+  }
+}
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(ctimer_process, ev, data)
+{
+  static unsigned short due;
+  struct ctimer *c;
+  PROCESS_BEGIN();
+
+  initialized = 1;
+  schedule();
+
+  while(1) {
+    PROCESS_YIELD_UNTIL(ev == PROCESS_EVENT_TIMER);
+
+    /* Count the timers that are due now and run that many
+       callbacks. Callbacks that set their own timer again with a
+       zero interval are thereby deferred to the next round. */
+    due = 0;
+    for(c = list_head(ctimer_list);
+	c != NULL && timer_expired(&c->etimer.timer);
+	c = c->next) {
+      ++due;
+    }
+
+    for(; due > 0; --due) {
+      c = list_head(ctimer_list);
+      if(c == NULL || !timer_expired(&c->etimer.timer)) {
+	break;
+      }
+      list_pop(ctimer_list);
+      c->etimer.p = PROCESS_NONE;
+      PROCESS_CONTEXT_BEGIN(c->p);
+      if(c->f != NULL) {
+	c->f(c->ptr);
+      }
+      PROCESS_CONTEXT_END(c->p);
+    }
+
+    schedule();
+  }
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
+void
+ctimer_init(void)
+{
+  initialized = 0;
+  list_init(ctimer_list);
+  process_start(&ctimer_process, NULL);
+}
+/*---------------------------------------------------------------------------*/
+void
+ctimer_set(struct ctimer *c, clock_time_t t,
+	   void (*f)(void *), void *ptr)
+{
+  PRINTF("ctimer_set %p %u\n", c, (unsigned)t);
+  c->p = PROCESS_CURRENT();
+  c->f = f;
+  c->ptr = ptr;
+  timer_set(&c->etimer.timer, t);
+  add_timer(c);
+}
+/*---------------------------------------------------------------------------*/
+void
+ctimer_reset(struct ctimer *c)
+{
+  timer_reset(&c->etimer.timer);
+  add_timer(c);
+}
+/*---------------------------------------------------------------------------*/
+void
+ctimer_restart(struct ctimer *c)
+{
+  timer_restart(&c->etimer.timer);
+  add_timer(c);
+}
+/*---------------------------------------------------------------------------*/
+void
+ctimer_stop(struct ctimer *c)
+{
+  list_remove(ctimer_list, c);
+  c->etimer.next = NULL;
+  c->etimer.p = PROCESS_NONE;
+}
+/*---------------------------------------------------------------------------*/
+int
+ctimer_expired(struct ctimer *c)
+{
+  return c->etimer.p == PROCESS_NONE;
+}
+/*---------------------------------------------------------------------------*/
+#else /* CTIMER_CONF_BATCH */
 PROCESS_THREAD(ctimer_process, ev, data)
 {
   struct ctimer *c;
@@ -168,5 +331,6 @@ ctimer_expired(struct ctimer *c)
   }
   return 1;
 }
+#endif /* CTIMER_CONF_BATCH */
 /*---------------------------------------------------------------------------*/
 /** @} */
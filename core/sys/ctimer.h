@@ -57,6 +57,16 @@
 
 #include "sys/etimer.h"
 
+/**
+ * When CTIMER_CONF_BATCH is set, all callback timers are kept on one
+ * list sorted by expiration time and share a single event timer.
+ * Every callback that is due is run when that event timer fires,
+ * instead of each callback timer posting its own timer event.
+ */
+#ifndef CTIMER_CONF_BATCH
+#define CTIMER_CONF_BATCH 0
+#endif /* CTIMER_CONF_BATCH */
+
 struct ctimer {
   struct ctimer *next;
   struct etimer etimer;
@@ -53,8 +53,116 @@
 struct etimer *timerlist;
 static clock_time_t next_expiration;
 
+#if ETIMER_HEAP_SIZE > 0
+/*
+ * Binary heap of timers ordered by expiration time, earliest first.
+ * Each timer keeps its 1-based position in the heap in heap_index,
+ * zero meaning that the timer is not in the heap.
+ */
+static struct etimer *heap[ETIMER_HEAP_SIZE];
+static unsigned short heap_len;
+
+#define EXPIRATION(t) ((t)->timer.start + (t)->timer.interval)
+#define HEAP(i) heap[(i) - 1]
+#endif /* ETIMER_HEAP_SIZE > 0 */
+
 PROCESS(etimer_process, "Event timer");
 /*---------------------------------------------------------------------------*/
+#if ETIMER_HEAP_SIZE > 0
+/* Wrap safe check if timer a expires before timer b. */
+static int
+expires_before(struct etimer *a, struct etimer *b)
+{
+  return (clock_time_t)(EXPIRATION(a) - EXPIRATION(b)) >
+    (clock_time_t)(~(clock_time_t)0 >> 1);
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_place(struct etimer *t, unsigned short i)
+{
+  HEAP(i) = t;
+  t->heap_index = i;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Restore the heap order for the timer at position i after its
+ * expiration time has changed or it was moved there.
+ */
+static void
+heap_sift(unsigned short i)
+{
+  struct etimer *t;
+  unsigned short c;
+
+  t = HEAP(i);
+
+  /* Move the timer towards the root while it expires before its
+     parent. */
+  while(i > 1 && expires_before(t, HEAP(i / 2))) {
+    heap_place(HEAP(i / 2), i);
+    i /= 2;
+  }
+
+  /* Move the timer towards the leaves while a child expires before
+     it. */
+  while((c = 2 * i) <= heap_len) {
+    if(c < heap_len && expires_before(HEAP(c + 1), HEAP(c))) {
+      ++c;
+    }
+    if(!expires_before(HEAP(c), t)) {
+      break;
+    }
+    heap_place(HEAP(c), i);
+    i = c;
+  }
+
+  heap_place(t, i);
+}
+/*---------------------------------------------------------------------------*/
+static int
+heap_contains(struct etimer *t)
+{
+  return t->heap_index > 0 && t->heap_index <= heap_len &&
+    HEAP(t->heap_index) == t;
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_remove(struct etimer *t)
+{
+  unsigned short i;
+
+  i = t->heap_index;
+  t->heap_index = 0;
+  --heap_len;
+  if(i <= heap_len) {
+    /* Fill the hole with the last timer in the heap. */
+    heap_place(HEAP(heap_len + 1), i);
+    heap_sift(i);
+  }
+}
+/*---------------------------------------------------------------------------*/
+static void
+heap_remove_process(struct process *p)
+{
+  unsigned short i, n;
+
+  /* Compact the heap without the timers of the process and rebuild
+     the heap order. Processes exit seldom, so O(n) is fine here. */
+  n = 0;
+  for(i = 1; i <= heap_len; ++i) {
+    if(HEAP(i)->p == p) {
+      HEAP(i)->heap_index = 0;
+    } else {
+      heap_place(HEAP(i), ++n);
+    }
+  }
+  heap_len = n;
+  for(i = heap_len / 2; i > 0; --i) {
+    heap_sift(i);
+  }
+}
+#endif /* ETIMER_HEAP_SIZE > 0 */
+/*---------------------------------------------------------------------------*/
 static void
 update_time(void)
 {
@@ -62,6 +170,15 @@ update_time(void)
   clock_time_t now;
   struct etimer *t;
 
+#if ETIMER_HEAP_SIZE > 0
+  /* The heap root is the next timer to expire, so unless timers
+     have overflowed onto the list there is nothing to scan. */
+  if(timerlist == NULL) {
+    next_expiration = heap_len > 0 ? EXPIRATION(HEAP(1)) : 0;
+    return;
+  }
+#endif /* ETIMER_HEAP_SIZE > 0 */
+
   if (timerlist == NULL) {
     next_expiration = 0;
   } else {
@@ -74,6 +191,11 @@ update_time(void)
 	tdist = t->timer.start + t->timer.interval - now;
       }
     }
+#if ETIMER_HEAP_SIZE > 0
+    if(heap_len > 0 && EXPIRATION(HEAP(1)) - now < tdist) {
+      tdist = EXPIRATION(HEAP(1)) - now;
+    }
+#endif /* ETIMER_HEAP_SIZE > 0 */
     next_expiration = now + tdist;
   }
 }
@@ -92,6 +214,11 @@ PROCESS_THREAD(etimer_process, ev, data)
     if(ev == PROCESS_EVENT_EXITED) {
       struct process *p = data;
 
+#if ETIMER_HEAP_SIZE > 0
+      heap_remove_process(p);
+      update_time();
+#endif /* ETIMER_HEAP_SIZE > 0 */
+
       while(timerlist != NULL && timerlist->p == p) {
 	timerlist = timerlist->next;
       }
@@ -110,6 +237,21 @@ PROCESS_THREAD(etimer_process, ev, data)
       continue;
     }
 
+#if ETIMER_HEAP_SIZE > 0
+    /* Expired timers are at the root of the heap. */
+    while(heap_len > 0 && timer_expired(&HEAP(1)->timer)) {
+      t = HEAP(1);
+      if(process_post(t->p, PROCESS_EVENT_TIMER, t) == PROCESS_ERR_OK) {
+	t->p = PROCESS_NONE;
+	heap_remove(t);
+	update_time();
+      } else {
+	etimer_request_poll();
+	break;
+      }
+    }
+#endif /* ETIMER_HEAP_SIZE > 0 */
+
   again:
     
     u = NULL;
@@ -157,6 +299,15 @@ add_timer(struct etimer *timer)
 
   if(timer->p != PROCESS_NONE) {
     /* Timer not on list. */
+
+#if ETIMER_HEAP_SIZE > 0
+    if(heap_contains(timer)) {
+      /* Timer already in the heap, move it to its new position. */
+      heap_sift(timer->heap_index);
+      update_time();
+      return;
+    }
+#endif /* ETIMER_HEAP_SIZE > 0 */
     
     for(t = timerlist; t != NULL; t = t->next) {
       if(t == timer) {
@@ -168,6 +319,17 @@ add_timer(struct etimer *timer)
   }
 
   timer->p = PROCESS_CURRENT();
+#if ETIMER_HEAP_SIZE > 0
+  if(heap_len < ETIMER_HEAP_SIZE) {
+    timer->next = NULL;
+    ++heap_len;
+    heap_place(timer, heap_len);
+    heap_sift(heap_len);
+    update_time();
+    return;
+  }
+  timer->heap_index = 0;
+#endif /* ETIMER_HEAP_SIZE > 0 */
   timer->next = timerlist;
   timerlist = timer;
 
@@ -199,6 +361,11 @@ void
 etimer_adjust(struct etimer *et, int timediff)
 {
   et->timer.start += timediff;
+#if ETIMER_HEAP_SIZE > 0
+  if(heap_contains(et)) {
+    heap_sift(et->heap_index);
+  }
+#endif /* ETIMER_HEAP_SIZE > 0 */
   update_time();
 }
 /*---------------------------------------------------------------------------*/
@@ -223,6 +390,11 @@ etimer_start_time(struct etimer *et)
 int
 etimer_pending(void)
 {
+#if ETIMER_HEAP_SIZE > 0
+  if(heap_len > 0) {
+    return 1;
+  }
+#endif /* ETIMER_HEAP_SIZE > 0 */
   return timerlist != NULL;
 }
 /*---------------------------------------------------------------------------*/
@@ -237,6 +409,12 @@ etimer_stop(struct etimer *et)
 {
   struct etimer *t;
 
+#if ETIMER_HEAP_SIZE > 0
+  if(heap_contains(et)) {
+    heap_remove(et);
+    update_time();
+  } else
+#endif /* ETIMER_HEAP_SIZE > 0 */
   /* First check if et is the first event timer on the list. */
   if(et == timerlist) {
     timerlist = timerlist->next;
@@ -66,6 +66,19 @@
 #include "sys/timer.h"
 #include "sys/process.h"
 
+/**
+ * The number of event timers that are kept in a binary heap ordered
+ * by expiration time. With the heap, setting and stopping a timer is
+ * O(log n) and finding the next expiration is O(1). Timers that do not
+ * fit in the heap are kept on an unsorted list. Zero, the default,
+ * keeps all timers on the unsorted list.
+ */
+#ifdef ETIMER_CONF_HEAP_SIZE
+#define ETIMER_HEAP_SIZE ETIMER_CONF_HEAP_SIZE
+#else /* ETIMER_CONF_HEAP_SIZE */
+#define ETIMER_HEAP_SIZE 0
+#endif /* ETIMER_CONF_HEAP_SIZE */
+
 /**
  * A timer.
  *
@@ -78,6 +91,9 @@ struct etimer {
   struct timer timer;
   struct etimer *next;
   struct process *p;
+#if ETIMER_HEAP_SIZE > 0
+  unsigned short heap_index;
+#endif /* ETIMER_HEAP_SIZE > 0 */
 };
 
 /**
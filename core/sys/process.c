@@ -46,8 +46,11 @@
 
 #include <stdio.h>
 
+#include <string.h>
+
 #include "sys/process.h"
 #include "sys/arg.h"
+#include "lib/memb.h"
 
 /*
  * Pointer to the currently running process structure.
@@ -64,17 +67,68 @@ struct event_data {
   process_event_t ev;
   process_data_t data;
   struct process *p;
+#if PROCESS_CONF_STATS && PROCESS_PRIORITIES > 1
+  clock_time_t posted;
+#endif
+#if PROCESS_CONF_ACCOUNTING
+  rtimer_clock_t stamp;
+#endif
+};
+
+#if PROCESS_CONF_OVERFLOW & PROCESS_OVERFLOW_SPILL
+/*
+ * Events that did not fit in a full event ring wait in a shared pool
+ * and are moved into the ring, in order, as it drains.
+ */
+struct spilled_event {
+  struct spilled_event *next;
+  struct event_data e;
 };
 
-static process_num_events_t nevents, fevent;
-static struct event_data events[PROCESS_CONF_NUMEVENTS];
+MEMB(spilled_events, struct spilled_event, PROCESS_CONF_SPILL_EVENTS);
+#endif /* PROCESS_CONF_OVERFLOW & PROCESS_OVERFLOW_SPILL */
+
+/*
+ * There is one event ring per priority level. With the default
+ * single priority level this is the plain FIFO event queue.
+ */
+struct event_queue {
+  process_num_events_t nevents, fevent;
+  struct event_data events[PROCESS_CONF_NUMEVENTS];
+#if PROCESS_CONF_OVERFLOW & PROCESS_OVERFLOW_SPILL
+  struct spilled_event *spill, *spill_tail;
+#endif /* PROCESS_CONF_OVERFLOW & PROCESS_OVERFLOW_SPILL */
+};
+
+static process_total_events_t nevents;
+static struct event_queue queues[PROCESS_PRIORITIES];
+
+#ifndef PROCESS_CONF_MAXEVENTS_HOOK
+#define PROCESS_CONF_MAXEVENTS_HOOK(n)
+#endif /* PROCESS_CONF_MAXEVENTS_HOOK */
 
 #if PROCESS_CONF_STATS
-process_num_events_t process_maxevents;
+process_total_events_t process_maxevents;
+unsigned long process_overflows, process_coalesced, process_spilled;
+#if PROCESS_PRIORITIES > 1
+struct process_prio_stats process_prio_stats[PROCESS_PRIORITIES];
+#endif
 #endif
 
 static volatile unsigned char poll_requested;
 
+#if PROCESS_CONF_SUBSCRIPTIONS > 0
+/*
+ * Table of broadcast event subscriptions. A free entry has p == NULL.
+ */
+struct subscription {
+  struct process *p;
+  process_event_t ev;
+};
+
+static struct subscription subscriptions[PROCESS_CONF_SUBSCRIPTIONS];
+#endif /* PROCESS_CONF_SUBSCRIPTIONS > 0 */
+
 #define PROCESS_STATE_NONE        0
 #define PROCESS_STATE_RUNNING     1
 #define PROCESS_STATE_CALLED      2
@@ -158,6 +212,18 @@ exit_process(struct process *p, struct process *fromprocess)
     }
   }
 
+#if PROCESS_CONF_SUBSCRIPTIONS > 0
+  /* Drop all subscriptions held by the exiting process. */
+  {
+    struct subscription *sp;
+    for(sp = subscriptions; sp < &subscriptions[PROCESS_CONF_SUBSCRIPTIONS]; ++sp) {
+      if(sp->p == p) {
+	sp->p = NULL;
+      }
+    }
+  }
+#endif /* PROCESS_CONF_SUBSCRIPTIONS > 0 */
+
   if(p == process_list) {
     process_list = process_list->next;
   } else {
@@ -176,6 +242,9 @@ static void
 call_process(struct process *p, process_event_t ev, process_data_t data)
 {
   int ret;
+#if PROCESS_CONF_ACCOUNTING
+  rtimer_clock_t start, t;
+#endif /* PROCESS_CONF_ACCOUNTING */
 
 #if DEBUG
   if(p->state == PROCESS_STATE_CALLED) {
@@ -186,9 +255,20 @@ call_process(struct process *p, process_event_t ev, process_data_t data)
   if((p->state & PROCESS_STATE_RUNNING) &&
      p->thread != NULL) {
     PRINTF("process: calling process '%s' with event %d\n", PROCESS_NAME_STRING(p), ev);
+#if PROCESS_CONF_ACCOUNTING
+    start = RTIMER_NOW();
+#endif /* PROCESS_CONF_ACCOUNTING */
     process_current = p;
     p->state = PROCESS_STATE_CALLED;
     ret = p->thread(&p->pt, ev, data);
+#if PROCESS_CONF_ACCOUNTING
+    t = RTIMER_NOW() - start;
+    p->acct.calls++;
+    p->acct.time += t;
+    if(t > p->acct.maxtime) {
+      p->acct.maxtime = t;
+    }
+#endif /* PROCESS_CONF_ACCOUNTING */
     if(ret == PT_EXITED ||
        ret == PT_ENDED ||
        ev == PROCESS_EVENT_EXIT) {
@@ -199,6 +279,33 @@ call_process(struct process *p, process_event_t ev, process_data_t data)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if PROCESS_CONF_ACCOUNTING
+/* The time the event that is being delivered was posted. */
+static rtimer_clock_t event_stamp;
+
+/*
+ * Account the time a queued event waited before being delivered to a
+ * process.
+ */
+static void
+account_delay(struct process *p)
+{
+  rtimer_clock_t t;
+
+  if((p->state & PROCESS_STATE_RUNNING) && p->thread != NULL) {
+    t = RTIMER_NOW() - event_stamp;
+    p->acct.events++;
+    p->acct.delay += t;
+    if(t > p->acct.maxdelay) {
+      p->acct.maxdelay = t;
+    }
+  }
+}
+#define ACCOUNT_DELAY(p) account_delay(p)
+#else /* PROCESS_CONF_ACCOUNTING */
+#define ACCOUNT_DELAY(p)
+#endif /* PROCESS_CONF_ACCOUNTING */
+/*---------------------------------------------------------------------------*/
 void
 process_exit(struct process *p)
 {
@@ -210,9 +317,20 @@ process_init(void)
 {
   lastevent = PROCESS_EVENT_MAX;
 
-  nevents = fevent = 0;
+  nevents = 0;
+  memset(queues, 0, sizeof(queues));
+#if PROCESS_CONF_SUBSCRIPTIONS > 0
+  memset(subscriptions, 0, sizeof(subscriptions));
+#endif /* PROCESS_CONF_SUBSCRIPTIONS > 0 */
+#if PROCESS_CONF_OVERFLOW & PROCESS_OVERFLOW_SPILL
+  memb_init(&spilled_events);
+#endif /* PROCESS_CONF_OVERFLOW & PROCESS_OVERFLOW_SPILL */
 #if PROCESS_CONF_STATS
   process_maxevents = 0;
+  process_overflows = process_coalesced = process_spilled = 0;
+#if PROCESS_PRIORITIES > 1
+  memset(process_prio_stats, 0, sizeof(process_prio_stats));
+#endif
 #endif /* PROCESS_CONF_STATS */
 
   process_current = process_list = NULL;
@@ -238,6 +356,35 @@ do_poll(void)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if PROCESS_CONF_SUBSCRIPTIONS > 0
+/*
+ * Deliver a broadcast event to the processes that have subscribed to
+ * it. Returns zero if no process has subscribed to the event.
+ */
+static int
+deliver_subscribed(process_event_t ev, process_data_t data)
+{
+  struct subscription *sp;
+  int delivered;
+
+  /* Entries never move in the table, so a subscriber that subscribes
+     or unsubscribes from within its event handler does not upset the
+     walk. */
+  delivered = 0;
+  for(sp = subscriptions; sp < &subscriptions[PROCESS_CONF_SUBSCRIPTIONS]; ++sp) {
+    if(sp->p != NULL && sp->ev == ev) {
+      if(poll_requested) {
+	do_poll();
+      }
+      ACCOUNT_DELAY(sp->p);
+      call_process(sp->p, ev, data);
+      delivered = 1;
+    }
+  }
+  return delivered;
+}
+#endif /* PROCESS_CONF_SUBSCRIPTIONS > 0 */
+/*---------------------------------------------------------------------------*/
 /*
  * Process the next event in the event queue and deliver it to
  * listening processes.
@@ -250,6 +397,8 @@ do_event(void)
   static process_data_t data;
   static struct process *receiver;
   static struct process *p;
+  struct event_queue *q;
+  struct event_data *e;
   
   /*
    * If there are any events in the queue, take the first one and walk
@@ -260,21 +409,61 @@ do_event(void)
    */
 
   if(nevents > 0) {
-    
+
+    /* Pick the highest priority level that has a pending event. */
+    for(q = &queues[PROCESS_PRIORITIES - 1];
+        q > &queues[0] && q->nevents == 0; --q);
+
     /* There are events that we should deliver. */
-    ev = events[fevent].ev;
+    e = &q->events[q->fevent];
+    ev = e->ev;
     
-    data = events[fevent].data;
-    receiver = events[fevent].p;
+    data = e->data;
+    receiver = e->p;
+
+#if PROCESS_CONF_STATS && PROCESS_PRIORITIES > 1
+    {
+      struct process_prio_stats *st = &process_prio_stats[q - queues];
+      clock_time_t wait = clock_time() - e->posted;
+
+      st->delivered++;
+      st->wait += wait;
+      if(wait > st->maxwait) {
+        st->maxwait = wait;
+      }
+    }
+#endif /* PROCESS_CONF_STATS && PROCESS_PRIORITIES > 1 */
+#if PROCESS_CONF_ACCOUNTING
+    event_stamp = e->stamp;
+#endif /* PROCESS_CONF_ACCOUNTING */
 
     /* Since we have seen the new event, we move pointer upwards
        and decrese the number of events. */
-    fevent = (fevent + 1) % PROCESS_CONF_NUMEVENTS;
+    q->fevent = (q->fevent + 1) % PROCESS_CONF_NUMEVENTS;
+    --q->nevents;
     --nevents;
 
-    /* If this is a broadcast event, we deliver it to all events, in
-       order of their priority. */
+#if PROCESS_CONF_OVERFLOW & PROCESS_OVERFLOW_SPILL
+    /* Move the oldest spilled event into the slot that was freed. */
+    if(q->spill != NULL) {
+      struct spilled_event *s = q->spill;
+
+      q->spill = s->next;
+      q->events[(q->fevent + q->nevents) % PROCESS_CONF_NUMEVENTS] = s->e;
+      ++q->nevents;
+      memb_free(&spilled_events, s);
+    }
+#endif /* PROCESS_CONF_OVERFLOW & PROCESS_OVERFLOW_SPILL */
+
+    /* If this is a broadcast event, we deliver it to the processes
+       that subscribed to it, or to all processes if there are no
+       subscribers. */
     if(receiver == PROCESS_BROADCAST) {
+#if PROCESS_CONF_SUBSCRIPTIONS > 0
+      if(deliver_subscribed(ev, data)) {
+	return;
+      }
+#endif /* PROCESS_CONF_SUBSCRIPTIONS > 0 */
       for(p = process_list; p != NULL; p = p->next) {
 
 	/* If we have been requested to poll a process, we do this in
@@ -282,6 +471,7 @@ do_event(void)
 	if(poll_requested) {
 	  do_poll();
 	}
+	ACCOUNT_DELAY(p);
 	call_process(p, ev, data);
       }
     } else {
@@ -294,6 +484,7 @@ do_event(void)
       }
 
       /* Make sure that the process actually is running. */
+      ACCOUNT_DELAY(receiver);
       call_process(receiver, ev, data);
     }
   }
@@ -320,9 +511,77 @@ process_nevents(void)
 }
 /*---------------------------------------------------------------------------*/
 int
+process_nevents_prio(unsigned char prio)
+{
+  if(prio >= PROCESS_PRIORITIES) {
+    return 0;
+  }
+  return queues[prio].nevents;
+}
+/*---------------------------------------------------------------------------*/
+void
+process_set_priority(struct process *p, unsigned char prio)
+{
+#if PROCESS_PRIORITIES > 1
+  if(prio >= PROCESS_PRIORITIES) {
+    prio = PROCESS_PRIO_HIGH;
+  }
+  p->priority = prio;
+#endif /* PROCESS_PRIORITIES > 1 */
+}
+/*---------------------------------------------------------------------------*/
+int
 process_post(struct process *p, process_event_t ev, process_data_t data)
+{
+  if(p == PROCESS_BROADCAST) {
+    return process_post_prio(p, ev, data, PROCESS_PRIO_LOW);
+  }
+  return process_post_prio(p, ev, data, PROCESS_PRIORITY(p));
+}
+/*---------------------------------------------------------------------------*/
+#if PROCESS_CONF_OVERFLOW & PROCESS_OVERFLOW_COALESCE
+/*
+ * Check if an identical event already is waiting in a queue.
+ */
+static int
+is_queued(struct event_queue *q, struct process *p, process_event_t ev,
+          process_data_t data)
+{
+  process_num_events_t i;
+  struct event_data *e;
+
+  for(i = 0; i < q->nevents; ++i) {
+    e = &q->events[(q->fevent + i) % PROCESS_CONF_NUMEVENTS];
+    if(e->p == p && e->ev == ev && e->data == data) {
+      return 1;
+    }
+  }
+#if PROCESS_CONF_OVERFLOW & PROCESS_OVERFLOW_SPILL
+  {
+    struct spilled_event *s;
+    for(s = q->spill; s != NULL; s = s->next) {
+      if(s->e.p == p && s->e.ev == ev && s->e.data == data) {
+	return 1;
+      }
+    }
+  }
+#endif /* PROCESS_CONF_OVERFLOW & PROCESS_OVERFLOW_SPILL */
+  return 0;
+}
+#endif /* PROCESS_CONF_OVERFLOW & PROCESS_OVERFLOW_COALESCE */
+/*---------------------------------------------------------------------------*/
+int
+process_post_prio(struct process *p, process_event_t ev, process_data_t data,
+                  unsigned char prio)
 {
   static process_num_events_t snum;
+  struct event_queue *q;
+  struct event_data *e;
+
+  if(prio >= PROCESS_PRIORITIES) {
+    prio = PROCESS_PRIO_HIGH;
+  }
+  q = &queues[prio];
 
   if(PROCESS_CURRENT() == NULL) {
     PRINTF("process_post: NULL process posts event %d to process '%s', nevents %d\n",
@@ -333,27 +592,76 @@ process_post(struct process *p, process_event_t ev, process_data_t data)
 	   p == PROCESS_BROADCAST? "<broadcast>": PROCESS_NAME_STRING(p), nevents);
   }
   
-  if(nevents == PROCESS_CONF_NUMEVENTS) {
-#if DEBUG
-    if(p == PROCESS_BROADCAST) {
-      printf("soft panic: event queue is full when broadcast event %d was posted from %s\n", ev, PROCESS_NAME_STRING(process_current));
-    } else {
-      printf("soft panic: event queue is full when event %d was posted to %s frpm %s\n", ev, PROCESS_NAME_STRING(p), PROCESS_NAME_STRING(process_current));
+  /* The ring stays full as long as there are spilled events, so new
+     events queue up behind the spilled ones. */
+  e = NULL;
+  if(q->nevents == PROCESS_CONF_NUMEVENTS) {
+#if PROCESS_CONF_OVERFLOW & PROCESS_OVERFLOW_COALESCE
+    if(is_queued(q, p, ev, data)) {
+#if PROCESS_CONF_STATS
+      ++process_coalesced;
+#endif /* PROCESS_CONF_STATS */
+      return PROCESS_ERR_OK;
+    }
+#endif /* PROCESS_CONF_OVERFLOW & PROCESS_OVERFLOW_COALESCE */
+#if PROCESS_CONF_OVERFLOW & PROCESS_OVERFLOW_SPILL
+    {
+      struct spilled_event *s = memb_alloc(&spilled_events);
+      if(s != NULL) {
+	s->next = NULL;
+	if(q->spill == NULL) {
+	  q->spill = s;
+	} else {
+	  q->spill_tail->next = s;
+	}
+	q->spill_tail = s;
+	e = &s->e;
+#if PROCESS_CONF_STATS
+	++process_spilled;
+#endif /* PROCESS_CONF_STATS */
+      }
     }
+#endif /* PROCESS_CONF_OVERFLOW & PROCESS_OVERFLOW_SPILL */
+    if(e == NULL) {
+#if DEBUG
+      if(p == PROCESS_BROADCAST) {
+	printf("soft panic: event queue is full when broadcast event %d was posted from %s\n", ev, PROCESS_NAME_STRING(process_current));
+      } else {
+	printf("soft panic: event queue is full when event %d was posted to %s frpm %s\n", ev, PROCESS_NAME_STRING(p), PROCESS_NAME_STRING(process_current));
+      }
 #endif /* DEBUG */
-    return PROCESS_ERR_FULL;
+#if PROCESS_CONF_STATS
+      ++process_overflows;
+#endif /* PROCESS_CONF_STATS */
+      return PROCESS_ERR_FULL;
+    }
+  } else {
+    snum = (process_num_events_t)(q->fevent + q->nevents) % PROCESS_CONF_NUMEVENTS;
+    e = &q->events[snum];
+    ++q->nevents;
   }
   
-  snum = (process_num_events_t)(fevent + nevents) % PROCESS_CONF_NUMEVENTS;
-  events[snum].ev = ev;
-  events[snum].data = data;
-  events[snum].p = p;
+  e->ev = ev;
+  e->data = data;
+  e->p = p;
+#if PROCESS_CONF_STATS && PROCESS_PRIORITIES > 1
+  e->posted = clock_time();
+#endif
+#if PROCESS_CONF_ACCOUNTING
+  e->stamp = RTIMER_NOW();
+#endif
   ++nevents;
 
 #if PROCESS_CONF_STATS
   if(nevents > process_maxevents) {
     process_maxevents = nevents;
+    PROCESS_CONF_MAXEVENTS_HOOK(nevents);
+  }
+#if PROCESS_PRIORITIES > 1
+  if(q->nevents > process_prio_stats[prio].maxevents) {
+    process_prio_stats[prio].maxevents = q->nevents;
   }
+#endif
 #endif /* PROCESS_CONF_STATS */
   
   return PROCESS_ERR_OK;
@@ -381,6 +689,49 @@ process_poll(struct process *p)
 }
 /*---------------------------------------------------------------------------*/
 int
+process_subscribe(process_event_t ev)
+{
+#if PROCESS_CONF_SUBSCRIPTIONS > 0
+  struct subscription *sp, *slot;
+
+  if(process_current == NULL) {
+    return PROCESS_ERR_FULL;
+  }
+
+  slot = NULL;
+  for(sp = subscriptions; sp < &subscriptions[PROCESS_CONF_SUBSCRIPTIONS]; ++sp) {
+    if(sp->p == process_current && sp->ev == ev) {
+      return PROCESS_ERR_OK;
+    }
+    if(sp->p == NULL && slot == NULL) {
+      slot = sp;
+    }
+  }
+  if(slot != NULL) {
+    slot->ev = ev;
+    slot->p = process_current;
+    return PROCESS_ERR_OK;
+  }
+#endif /* PROCESS_CONF_SUBSCRIPTIONS > 0 */
+  return PROCESS_ERR_FULL;
+}
+/*---------------------------------------------------------------------------*/
+void
+process_unsubscribe(process_event_t ev)
+{
+#if PROCESS_CONF_SUBSCRIPTIONS > 0
+  struct subscription *sp;
+
+  for(sp = subscriptions; sp < &subscriptions[PROCESS_CONF_SUBSCRIPTIONS]; ++sp) {
+    if(sp->p == process_current && sp->ev == ev) {
+      sp->p = NULL;
+      return;
+    }
+  }
+#endif /* PROCESS_CONF_SUBSCRIPTIONS > 0 */
+}
+/*---------------------------------------------------------------------------*/
+int
 process_is_running(struct process *p)
 {
   return p->state != PROCESS_STATE_NONE;
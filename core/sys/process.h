@@ -89,6 +89,105 @@ typedef unsigned char process_num_events_t;
 #define PROCESS_CONF_NUMEVENTS 32
 #endif /* PROCESS_CONF_NUMEVENTS */
 
+/**
+ * The number of broadcast event subscriptions that can be held by
+ * all processes together. Zero disables subscriptions.
+ */
+#ifndef PROCESS_CONF_SUBSCRIPTIONS
+#define PROCESS_CONF_SUBSCRIPTIONS 0
+#endif /* PROCESS_CONF_SUBSCRIPTIONS */
+
+/**
+ * \name Event queue overflow policies
+ *
+ * PROCESS_CONF_OVERFLOW selects what process_post() does when the
+ * event queue is full. By default the event is rejected with
+ * PROCESS_ERR_FULL. With PROCESS_OVERFLOW_COALESCE, an event that is
+ * identical to one already in the queue (same process, event and
+ * data) is dropped and PROCESS_ERR_OK returned. With
+ * PROCESS_OVERFLOW_SPILL, the event is put in a shared pool of
+ * PROCESS_CONF_SPILL_EVENTS entries and moved into the queue as it
+ * drains. The policies can be combined, in which case coalescing is
+ * tried first. With PROCESS_CONF_STATS, rejected, coalesced and
+ * spilled events are counted in process_overflows, process_coalesced
+ * and process_spilled, and PROCESS_CONF_MAXEVENTS_HOOK(n), if
+ * defined, is called each time a new peak of n queued events is
+ * reached.
+ * @{
+ */
+#define PROCESS_OVERFLOW_REJECT   0
+#define PROCESS_OVERFLOW_COALESCE 1
+#define PROCESS_OVERFLOW_SPILL    2
+
+#ifndef PROCESS_CONF_OVERFLOW
+#define PROCESS_CONF_OVERFLOW PROCESS_OVERFLOW_REJECT
+#endif /* PROCESS_CONF_OVERFLOW */
+
+#ifndef PROCESS_CONF_SPILL_EVENTS
+#define PROCESS_CONF_SPILL_EVENTS 8
+#endif /* PROCESS_CONF_SPILL_EVENTS */
+/** @} */
+
+/**
+ * When PROCESS_CONF_ACCOUNTING is set, the kernel keeps per-process
+ * run time and event delay statistics in the acct field of struct
+ * process, measured in rtimer ticks.
+ */
+#ifndef PROCESS_CONF_ACCOUNTING
+#define PROCESS_CONF_ACCOUNTING 0
+#endif /* PROCESS_CONF_ACCOUNTING */
+
+#if PROCESS_CONF_ACCOUNTING
+#include "sys/rtimer.h"
+
+/**
+ * Per-process accounting. Run times include the time spent in
+ * processes that are called synchronously with process_post_synch().
+ */
+struct process_acct {
+  /** Number of times the process was called, and total run time. */
+  unsigned long calls, time;
+  /** Longest single run. */
+  rtimer_clock_t maxtime;
+  /** Number of queued events delivered, and total time they waited
+      in the event queue. */
+  unsigned long events, delay;
+  /** Longest time an event waited in the event queue. */
+  rtimer_clock_t maxdelay;
+};
+#endif /* PROCESS_CONF_ACCOUNTING */
+
+/**
+ * \name Event priorities
+ *
+ * The kernel can keep one event queue per priority level. Events in a
+ * higher level queue are always delivered before events in lower
+ * level queues, while events within one level are delivered in FIFO
+ * order. Each level has room for PROCESS_CONF_NUMEVENTS events. The
+ * default is a single level, which gives the traditional FIFO
+ * behavior.
+ * @{
+ */
+#ifdef PROCESS_CONF_PRIORITIES
+#define PROCESS_PRIORITIES PROCESS_CONF_PRIORITIES
+#else /* PROCESS_CONF_PRIORITIES */
+#define PROCESS_PRIORITIES 1
+#endif /* PROCESS_CONF_PRIORITIES */
+
+#define PROCESS_PRIO_LOW  0
+#define PROCESS_PRIO_HIGH (PROCESS_PRIORITIES - 1)
+
+/*
+ * The number of events in all queues together needs a wider counter
+ * than a single queue once the levels can hold more than 255 events.
+ */
+#if PROCESS_PRIORITIES * PROCESS_CONF_NUMEVENTS > 255
+typedef unsigned short process_total_events_t;
+#else
+typedef process_num_events_t process_total_events_t;
+#endif
+/** @} */
+
 #define PROCESS_EVENT_NONE            0x80
 #define PROCESS_EVENT_INIT            0x81
 #define PROCESS_EVENT_POLL            0x82
@@ -324,6 +423,15 @@ struct process {
   PT_THREAD((* thread)(struct pt *, process_event_t, process_data_t));
   struct pt pt;
   unsigned char state, needspoll;
+#if PROCESS_PRIORITIES > 1
+  unsigned char priority;
+#define PROCESS_PRIORITY(process) (process)->priority
+#else
+#define PROCESS_PRIORITY(process) PROCESS_PRIO_LOW
+#endif
+#if PROCESS_CONF_ACCOUNTING
+  struct process_acct acct;
+#endif /* PROCESS_CONF_ACCOUNTING */
 };
 
 /**
@@ -365,6 +473,71 @@ CCIF void process_start(struct process *p, const char *arg);
  */
 CCIF int process_post(struct process *p, process_event_t ev, void* data);
 
+/**
+ * Post an asynchronous event with an explicit priority.
+ *
+ * This function works like process_post(), but places the event in
+ * the queue of the given priority level instead of the priority of
+ * the receiving process. process_post() uses the priority of the
+ * receiving process, and PROCESS_PRIO_LOW for broadcast events.
+ *
+ * \param p The process to which the event should be posted, or
+ * PROCESS_BROADCAST.
+ *
+ * \param ev The event to be posted.
+ *
+ * \param data The auxiliary data to be sent with the event
+ *
+ * \param prio The priority level, PROCESS_PRIO_LOW to
+ * PROCESS_PRIO_HIGH. Larger values are clamped to PROCESS_PRIO_HIGH.
+ *
+ * \retval PROCESS_ERR_OK The event could be posted.
+ *
+ * \retval PROCESS_ERR_FULL The event queue for the priority level
+ * was full and the event could not be posted.
+ */
+CCIF int process_post_prio(struct process *p, process_event_t ev, void* data,
+                           unsigned char prio);
+
+/**
+ * Set the event priority of a process.
+ *
+ * Events posted to the process with process_post() are queued at
+ * this priority level. Processes start at PROCESS_PRIO_LOW. The call
+ * has no effect when only a single priority level is configured.
+ *
+ * \param p A pointer to the process' process structure.
+ *
+ * \param prio The priority level, PROCESS_PRIO_LOW to PROCESS_PRIO_HIGH.
+ */
+CCIF void process_set_priority(struct process *p, unsigned char prio);
+
+/**
+ * Subscribe the current process to a broadcast event.
+ *
+ * Once one or more processes have subscribed to an event, broadcasts
+ * of that event are only delivered to the subscribers instead of to
+ * every process in the system. Broadcasts of events that nobody has
+ * subscribed to are still delivered to all processes. Subscriptions
+ * are dropped when the process exits.
+ *
+ * \param ev The event to subscribe to.
+ *
+ * \retval PROCESS_ERR_OK The process is subscribed to the event.
+ *
+ * \retval PROCESS_ERR_FULL The subscription table was full, no
+ * process is running, or subscriptions are disabled
+ * (PROCESS_CONF_SUBSCRIPTIONS is zero).
+ */
+CCIF int process_subscribe(process_event_t ev);
+
+/**
+ * Unsubscribe the current process from a broadcast event.
+ *
+ * \param ev The event to unsubscribe from.
+ */
+CCIF void process_unsubscribe(process_event_t ev);
+
 /**
  * Post a synchronous event to a process.
  *
@@ -520,8 +693,41 @@ CCIF int process_is_running(struct process *p);
  */
 int process_nevents(void);
 
+/**
+ *  Number of events waiting in the queue of one priority level.
+ *
+ * \param prio The priority level.
+ * \return The number of events that are currently waiting in the
+ * queue of the priority level.
+ */
+int process_nevents_prio(unsigned char prio);
+
 /** @} */
 
+#if PROCESS_CONF_STATS
+extern process_total_events_t process_maxevents;
+extern unsigned long process_overflows, process_coalesced, process_spilled;
+#endif /* PROCESS_CONF_STATS */
+
+#if PROCESS_CONF_STATS && PROCESS_PRIORITIES > 1
+#include "sys/clock.h"
+
+/**
+ * Per-priority event queue statistics, indexed by priority level.
+ */
+struct process_prio_stats {
+  /** Highest number of events seen in the queue. */
+  process_num_events_t maxevents;
+  /** Number of events delivered from the queue. */
+  unsigned long delivered;
+  /** Cumulative time events spent in the queue. */
+  unsigned long wait;
+  /** Longest time an event spent in the queue. */
+  clock_time_t maxwait;
+};
+extern struct process_prio_stats process_prio_stats[PROCESS_PRIORITIES];
+#endif /* PROCESS_CONF_STATS && PROCESS_PRIORITIES > 1 */
+
 CCIF extern struct process *process_list;
 
 #define PROCESS_LIST() process_list
@@ -56,6 +56,123 @@
 #define PRINTF(...)
 #endif
 
+#if RTIMER_QUEUE_SIZE > 1
+/*
+ * Pending real-time tasks sorted by deadline, earliest first. Only
+ * the deadline of the first task is programmed into the hardware.
+ */
+static struct rtimer *queue[RTIMER_QUEUE_SIZE];
+static unsigned char queued;
+static unsigned char running;
+
+unsigned long rtimer_late;
+rtimer_clock_t rtimer_max_late;
+
+/*---------------------------------------------------------------------------*/
+void
+rtimer_init(void)
+{
+  queued = 0;
+  running = 0;
+  rtimer_late = 0;
+  rtimer_max_late = 0;
+  rtimer_arch_init();
+}
+/*---------------------------------------------------------------------------*/
+static void
+remove_task(unsigned char i)
+{
+  --queued;
+  for(; i < queued; ++i) {
+    queue[i] = queue[i + 1];
+  }
+}
+/*---------------------------------------------------------------------------*/
+int
+rtimer_set(struct rtimer *rtimer, rtimer_clock_t time,
+	   rtimer_clock_t duration,
+	   rtimer_callback_t func, void *ptr)
+{
+  rtimer_arch_irq_t s;
+  unsigned char i;
+
+  PRINTF("rtimer_set time %d\n", time);
+
+  s = RTIMER_ARCH_DISABLE_IRQ();
+
+  /* A task that is already queued is moved to its new deadline. */
+  for(i = 0; i < queued; ++i) {
+    if(queue[i] == rtimer) {
+      remove_task(i);
+      break;
+    }
+  }
+
+  if(queued == RTIMER_QUEUE_SIZE) {
+    RTIMER_ARCH_RESTORE_IRQ(s);
+    return RTIMER_ERR_FULL;
+  }
+
+  rtimer->func = func;
+  rtimer->ptr = ptr;
+  rtimer->time = time;
+
+  /* Insert after all tasks with an earlier or equal deadline. */
+  for(i = queued; i > 0 && RTIMER_CLOCK_LT(time, queue[i - 1]->time); --i) {
+    queue[i] = queue[i - 1];
+  }
+  queue[i] = rtimer;
+  ++queued;
+
+  /* The hardware is reprogrammed when rtimer_run_next() returns if we
+     are called from a task. */
+  if(i == 0 && !running) {
+    rtimer_arch_schedule(time);
+  }
+  RTIMER_ARCH_RESTORE_IRQ(s);
+  return RTIMER_OK;
+}
+/*---------------------------------------------------------------------------*/
+void
+rtimer_run_next(void)
+{
+  rtimer_arch_irq_t s;
+  struct rtimer *t;
+  rtimer_clock_t late;
+
+  s = RTIMER_ARCH_DISABLE_IRQ();
+  running = 1;
+
+  /* Run the first task and any task that became due while it ran. The
+     tasks run with the queue unlocked so that they can set timers. */
+  do {
+    if(queued == 0) {
+      break;
+    }
+    t = queue[0];
+    remove_task(0);
+    RTIMER_ARCH_RESTORE_IRQ(s);
+
+    late = RTIMER_NOW() - t->time;
+    if(!RTIMER_CLOCK_LT(late, RTIMER_LATE_THRESHOLD)) {
+      ++rtimer_late;
+      if(RTIMER_CLOCK_LT(rtimer_max_late, late)) {
+	rtimer_max_late = late;
+      }
+    }
+
+    t->func(t, t->ptr);
+    s = RTIMER_ARCH_DISABLE_IRQ();
+  } while(queued > 0 && !RTIMER_CLOCK_LT(RTIMER_NOW(), queue[0]->time));
+
+  running = 0;
+
+  if(queued > 0) {
+    rtimer_arch_schedule(queue[0]->time);
+  }
+  RTIMER_ARCH_RESTORE_IRQ(s);
+}
+#else /* RTIMER_QUEUE_SIZE > 1 */
 static struct rtimer *next_rtimer;
 
 /*---------------------------------------------------------------------------*/
@@ -105,4 +222,5 @@ rtimer_run_next(void)
   }
   return;
 }
+#endif /* RTIMER_QUEUE_SIZE > 1 */
 /*---------------------------------------------------------------------------*/
@@ -62,6 +62,39 @@ typedef unsigned short rtimer_clock_t;
 
 #include "rtimer-arch.h"
 
+/*
+ * The number of real-time tasks that can be pending at the same
+ * time. With the default of one, setting a task replaces the pending
+ * one. With more, tasks are queued by deadline and the architecture
+ * timer is always programmed with the earliest deadline.
+ */
+#ifdef RTIMER_CONF_QUEUE_SIZE
+#define RTIMER_QUEUE_SIZE RTIMER_CONF_QUEUE_SIZE
+#else /* RTIMER_CONF_QUEUE_SIZE */
+#define RTIMER_QUEUE_SIZE 1
+#endif /* RTIMER_CONF_QUEUE_SIZE */
+
+/*
+ * The task queue is updated both from rtimer_set() and from the timer
+ * interrupt, so the architecture must provide a way to mask that
+ * interrupt: RTIMER_ARCH_DISABLE_IRQ() masks it and returns the
+ * previous state, of type rtimer_arch_irq_t, which
+ * RTIMER_ARCH_RESTORE_IRQ() restores.
+ */
+#if RTIMER_QUEUE_SIZE > 1 && !defined(RTIMER_ARCH_DISABLE_IRQ)
+#error "RTIMER_CONF_QUEUE_SIZE > 1 needs RTIMER_ARCH_DISABLE_IRQ() in rtimer-arch.h"
+#endif
+
+/*
+ * A task that runs this many ticks or more after its deadline is
+ * counted as late in rtimer_late.
+ */
+#ifdef RTIMER_CONF_LATE_THRESHOLD
+#define RTIMER_LATE_THRESHOLD RTIMER_CONF_LATE_THRESHOLD
+#else /* RTIMER_CONF_LATE_THRESHOLD */
+#define RTIMER_LATE_THRESHOLD 2
+#endif /* RTIMER_CONF_LATE_THRESHOLD */
+
 /**
  * \brief      Initialize the real-time scheduler.
  *
@@ -101,11 +134,13 @@ enum {
  * \param duration Unused argument.
  * \param func A function to be called when the task is executed.
  * \param ptr An opaque pointer that will be supplied as an argument to the callback function.
- * \return     Non-zero (true) if the task could be scheduled, zero
- *             (false) if the task could not be scheduled.
+ * \return     RTIMER_OK if the task could be scheduled,
+ *             RTIMER_ERR_FULL if RTIMER_CONF_QUEUE_SIZE tasks
+ *             already are pending.
  *
  *             This function schedules a real-time task at a specified
- *             time in the future.
+ *             time in the future. Setting a task that already is
+ *             pending moves it to the new time.
  *
  */
 int rtimer_set(struct rtimer *task, rtimer_clock_t time,
@@ -120,6 +155,15 @@ int rtimer_set(struct rtimer *task, rtimer_clock_t time,
  */
 void rtimer_run_next(void);
 
+#if RTIMER_QUEUE_SIZE > 1
+/**
+ * The number of tasks that ran RTIMER_LATE_THRESHOLD ticks or more
+ * after their deadline, and the largest delay seen.
+ */
+extern unsigned long rtimer_late;
+extern rtimer_clock_t rtimer_max_late;
+#endif /* RTIMER_QUEUE_SIZE > 1 */
+
 /**
  * \brief      Get the current clock time
  * \return     The current time
@@ -35,10 +35,15 @@
 #define __RTIMER_ARCH_H__
 
 #include <avr/interrupt.h>
+#include "avrdef.h"
 
 /* Will affect radio on/off timing for cx-mac */
 #define RTIMER_ARCH_SECOND (8192)
 
+typedef spl_t rtimer_arch_irq_t;
+#define RTIMER_ARCH_DISABLE_IRQ()  splhigh()
+#define RTIMER_ARCH_RESTORE_IRQ(s) splx(s)
+
 
 
 /* Handle that not all AVRs have TCNT3 - this should be configuratble
@@ -42,10 +42,16 @@
 #define __RTIMER_ARCH_H__
 
 #include <io.h>
-#include "sys/rtimer.h"
+#include "msp430def.h"
 
 #define RTIMER_ARCH_SECOND (4096U*8)
 
+typedef spl_t rtimer_arch_irq_t;
+#define RTIMER_ARCH_DISABLE_IRQ()  splhigh()
+#define RTIMER_ARCH_RESTORE_IRQ(s) splx(s)
+
+#include "sys/rtimer.h"
+
 rtimer_clock_t rtimer_arch_now(void);
 
 #endif /* __RTIMER_ARCH_H__ */
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2011, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Tickless idle support for the native platforms
+ */
+
+#include <stdio.h>
+#include <sys/select.h>
+#include <sys/time.h>
+
+#include "contiki.h"
+#include "native-select.h"
+
+#ifndef DEBUG_SLEEP
+#define DEBUG_SLEEP 0
+#endif /* DEBUG_SLEEP */
+
+struct select_fd {
+  int fd;
+  void (* callback)(int fd);
+};
+
+/* Differences of clock values at or above this are negative. */
+#define CLOCK_HALF ((clock_time_t)~(clock_time_t)0 / 2 + 1)
+
+static struct select_fd fds[NATIVE_SELECT_FDS];
+static int nfds;
+
+/*---------------------------------------------------------------------------*/
+int
+native_select_set_callback(int fd, void (* callback)(int fd))
+{
+  int i;
+
+  for(i = 0; i < nfds; ++i) {
+    if(fds[i].fd == fd) {
+      if(callback != NULL) {
+        fds[i].callback = callback;
+      } else {
+        fds[i] = fds[--nfds];
+      }
+      return 1;
+    }
+  }
+
+  if(callback == NULL) {
+    return 1;
+  }
+  if(fd < 0 || fd >= FD_SETSIZE || nfds == NATIVE_SELECT_FDS) {
+    return 0;
+  }
+  fds[nfds].fd = fd;
+  fds[nfds].callback = callback;
+  ++nfds;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+static int
+etimer_due(void)
+{
+  return etimer_pending() &&
+    (clock_time_t)(clock_time() - etimer_next_expiration_time()) < CLOCK_HALF;
+}
+/*---------------------------------------------------------------------------*/
+void
+native_select_wait(int pending)
+{
+  fd_set readfds;
+  struct timeval tv, *timeout;
+  clock_time_t next_event;
+  int i, maxfd, ready;
+
+  timeout = &tv;
+  tv.tv_sec = tv.tv_usec = 0;
+  if(!pending && etimer_pending()) {
+    next_event = etimer_next_expiration_time() - clock_time();
+    if(next_event >= CLOCK_HALF) {
+      /* Already expired. */
+      next_event = 0;
+    }
+    tv.tv_sec = next_event / CLOCK_SECOND;
+    tv.tv_usec = (next_event % CLOCK_SECOND) * (1000000 / CLOCK_SECOND);
+  } else if(!pending) {
+    /* Nothing scheduled: sleep until a descriptor becomes ready. */
+    timeout = NULL;
+  }
+
+#if DEBUG_SLEEP
+  if(pending) {
+    printf("%d events pending\n", pending);
+  } else if(timeout != NULL) {
+    printf("next event: T-%.03f\n", (double)next_event / (double)CLOCK_SECOND);
+  } else {
+    printf("next event: none\n");
+  }
+#endif /* DEBUG_SLEEP */
+
+  FD_ZERO(&readfds);
+  maxfd = -1;
+  for(i = 0; i < nfds; ++i) {
+    FD_SET(fds[i].fd, &readfds);
+    if(fds[i].fd > maxfd) {
+      maxfd = fds[i].fd;
+    }
+  }
+
+  ready = select(maxfd + 1, &readfds, NULL, NULL, timeout);
+
+  /* Walk backwards so that a callback may remove its own descriptor. */
+  for(i = nfds - 1; ready > 0 && i >= 0; --i) {
+    if(i < nfds && FD_ISSET(fds[i].fd, &readfds)) {
+      FD_CLR(fds[i].fd, &readfds);
+      --ready;
+      fds[i].callback(fds[i].fd);
+    }
+  }
+
+  if(etimer_due()) {
+    etimer_request_poll();
+  }
+}
+/*---------------------------------------------------------------------------*/
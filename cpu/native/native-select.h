@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2011, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Tickless idle support for the native platforms
+ *
+ *         The main loop of a native platform calls
+ *         native_select_wait() after process_run(). The call sleeps
+ *         in select() until the next etimer expires or until one of
+ *         the registered file descriptors becomes readable, and then
+ *         runs the callbacks of the ready descriptors. There is no
+ *         periodic wakeup: a node with no pending timers and no
+ *         input sleeps indefinitely.
+ */
+
+#ifndef __NATIVE_SELECT_H__
+#define __NATIVE_SELECT_H__
+
+#include "contiki-conf.h"
+
+#ifdef NATIVE_SELECT_CONF_FDS
+#define NATIVE_SELECT_FDS NATIVE_SELECT_CONF_FDS
+#else /* NATIVE_SELECT_CONF_FDS */
+#define NATIVE_SELECT_FDS 8
+#endif /* NATIVE_SELECT_CONF_FDS */
+
+/**
+ * \brief      Register a file descriptor with the idle loop
+ * \param fd   The file descriptor
+ * \param callback Called with fd when fd is readable, or NULL to remove fd
+ * \retval 1   The descriptor was registered, updated or removed
+ * \retval 0   The table of descriptors is full
+ *
+ *             The callback runs from the main loop, outside of any
+ *             process. It typically reads the descriptor or polls
+ *             the process that owns it. A callback that leaves the
+ *             descriptor readable is called again on the next pass.
+ */
+int native_select_set_callback(int fd, void (* callback)(int fd));
+
+/**
+ * \brief      Sleep until there is something to do
+ * \param pending Non-zero if process_run() reported more work
+ *
+ *             Blocks until the next etimer expiration or until a
+ *             registered descriptor becomes readable, whichever comes
+ *             first, then runs the callbacks of the ready
+ *             descriptors and polls the etimer process if a timer
+ *             has expired. If pending is non-zero the call does not
+ *             block, but ready descriptors are still serviced.
+ */
+void native_select_wait(int pending);
+
+#endif /* __NATIVE_SELECT_H__ */
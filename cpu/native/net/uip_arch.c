@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2011, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Internet checksum for the native platforms
+ *
+ *         The data is summed 32 bits at a time into a 64-bit
+ *         accumulator, or 128 bits at a time with SSE2 when the
+ *         compiler targets it. The sum is taken in host byte order
+ *         and swapped at the end, which RFC 1071 shows gives the same
+ *         result as summing big endian 16-bit words.
+ */
+
+#include <string.h>
+#include <stdint.h>
+
+#include "net/uip.h"
+#include "net/uip_arch.h"
+
+#if UIP_ARCH_CHKSUM
+
+#ifdef UIP_ARCH_CONF_CHKSUM_SSE2
+#define CHKSUM_SSE2 UIP_ARCH_CONF_CHKSUM_SSE2
+#else
+#define CHKSUM_SSE2 1
+#endif
+
+#if CHKSUM_SSE2 && defined(__SSE2__)
+#include <emmintrin.h>
+#else
+#undef CHKSUM_SSE2
+#define CHKSUM_SSE2 0
+#endif
+
+#if UIP_CONF_IPV6
+#define UIP_IP_BUF ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define EXT_LEN uip_ext_len
+#else /* UIP_CONF_IPV6 */
+#define UIP_IP_BUF ((struct uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define EXT_LEN 0
+#endif /* UIP_CONF_IPV6 */
+
+/*---------------------------------------------------------------------------*/
+static uint64_t
+sum_words(const u8_t *data, u16_t len)
+{
+  uint64_t acc;
+  uint32_t w;
+  uint16_t h;
+
+  acc = 0;
+
+#if CHKSUM_SSE2
+  if(len >= 64) {
+    __m128i zero, v, acc2;
+    uint64_t lanes[2];
+
+    zero = _mm_setzero_si128();
+    acc2 = zero;
+    while(len >= 16) {
+      v = _mm_loadu_si128((const __m128i *)data);
+      /* Widen the four 32-bit words to 64 bits so nothing carries out. */
+      acc2 = _mm_add_epi64(acc2, _mm_unpacklo_epi32(v, zero));
+      acc2 = _mm_add_epi64(acc2, _mm_unpackhi_epi32(v, zero));
+      data += 16;
+      len -= 16;
+    }
+    _mm_storeu_si128((__m128i *)lanes, acc2);
+    acc = lanes[0] + lanes[1];
+  }
+#endif /* CHKSUM_SSE2 */
+
+  while(len >= 16) {
+    memcpy(&w, data, 4);
+    acc += w;
+    memcpy(&w, data + 4, 4);
+    acc += w;
+    memcpy(&w, data + 8, 4);
+    acc += w;
+    memcpy(&w, data + 12, 4);
+    acc += w;
+    data += 16;
+    len -= 16;
+  }
+  while(len >= 4) {
+    memcpy(&w, data, 4);
+    acc += w;
+    data += 4;
+    len -= 4;
+  }
+  if(len >= 2) {
+    memcpy(&h, data, 2);
+    acc += h;
+    data += 2;
+    len -= 2;
+  }
+  if(len > 0) {
+    /* The last byte is the high half of a zero padded word. */
+#if UIP_BYTE_ORDER == UIP_BIG_ENDIAN
+    acc += (uint16_t)(*data << 8);
+#else
+    acc += *data;
+#endif
+  }
+  return acc;
+}
+/*---------------------------------------------------------------------------*/
+static u16_t
+chksum(u16_t sum, const u8_t *data, u16_t len)
+{
+  uint64_t acc;
+
+  acc = sum_words(data, len);
+
+  /* Fold to 16 bits. */
+  acc = (acc >> 32) + (acc & 0xffffffff);
+  acc = (acc >> 16) + (acc & 0xffff);
+  acc = (acc >> 16) + (acc & 0xffff);
+  acc = (acc >> 16) + (acc & 0xffff);
+
+#if UIP_BYTE_ORDER != UIP_BIG_ENDIAN
+  acc = ((acc & 0xff) << 8) | (acc >> 8);
+#endif
+
+  /* Add the partial sum, which is in host byte order. */
+  acc += sum;
+  acc = (acc >> 16) + (acc & 0xffff);
+  return (u16_t)acc;
+}
+/*---------------------------------------------------------------------------*/
+u16_t
+uip_chksum(u16_t *data, u16_t len)
+{
+  return uip_htons(chksum(0, (u8_t *)data, len));
+}
+/*---------------------------------------------------------------------------*/
+#ifndef UIP_ARCH_IPCHKSUM
+u16_t
+uip_ipchksum(void)
+{
+  u16_t sum;
+
+  sum = chksum(0, &uip_buf[UIP_LLH_LEN], UIP_IPH_LEN);
+  return (sum == 0) ? 0xffff : uip_htons(sum);
+}
+#endif
+/*---------------------------------------------------------------------------*/
+static u16_t
+upper_layer_chksum(u8_t proto)
+{
+  u16_t upper_layer_len;
+  u16_t sum;
+
+#if UIP_CONF_IPV6
+  upper_layer_len = (((u16_t)(UIP_IP_BUF->len[0]) << 8) + UIP_IP_BUF->len[1] -
+                     EXT_LEN);
+#else /* UIP_CONF_IPV6 */
+  upper_layer_len = (((u16_t)(UIP_IP_BUF->len[0]) << 8) + UIP_IP_BUF->len[1]) -
+    UIP_IPH_LEN;
+#endif /* UIP_CONF_IPV6 */
+
+  /* First sum pseudoheader. */
+  /* IP protocol and length fields. This addition cannot carry. */
+  sum = upper_layer_len + proto;
+  /* Sum IP source and destination addresses. */
+  sum = chksum(sum, (u8_t *)&UIP_IP_BUF->srcipaddr, 2 * sizeof(uip_ipaddr_t));
+
+  /* Sum TCP header and data. */
+  sum = chksum(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN + EXT_LEN],
+               upper_layer_len);
+
+  return (sum == 0) ? 0xffff : uip_htons(sum);
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_CONF_IPV6
+u16_t
+uip_icmp6chksum(void)
+{
+  return upper_layer_chksum(UIP_PROTO_ICMP6);
+}
+#endif /* UIP_CONF_IPV6 */
+/*---------------------------------------------------------------------------*/
+u16_t
+uip_tcpchksum(void)
+{
+  return upper_layer_chksum(UIP_PROTO_TCP);
+}
+/*---------------------------------------------------------------------------*/
+u16_t
+uip_udpchksum(void)
+{
+  return upper_layer_chksum(UIP_PROTO_UDP);
+}
+/*---------------------------------------------------------------------------*/
+#endif /* UIP_ARCH_CHKSUM */
@@ -47,4 +47,12 @@
 
 #define rtimer_arch_now() clock_time()
 
+/* The timer interrupt is SIGALRM, which is blocked while the task
+   queue is updated */
+typedef int rtimer_arch_irq_t;
+int rtimer_arch_disable_irq(void);
+void rtimer_arch_restore_irq(int s);
+#define RTIMER_ARCH_DISABLE_IRQ()  rtimer_arch_disable_irq()
+#define RTIMER_ARCH_RESTORE_IRQ(s) rtimer_arch_restore_irq(s)
+
 #endif /* __RTIMER_ARCH_H__ */
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2010, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Packets per second through the 6lowpan HC06 output path
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+#include "net/netstack.h"
+#include "net/sicslowpan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PACKETS     2000000UL
+#define PAYLOAD_LEN 16
+
+#define UIP_IP_BUF  ((struct uip_ip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UIP_UDP_BUF ((struct uip_udp_hdr *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN])
+
+/*---------------------------------------------------------------------------*/
+/* A MAC that drops every frame and reports it as sent */
+static void
+bench_mac_send(mac_callback_t sent, void *ptr)
+{
+  mac_call_sent_callback(sent, ptr, MAC_TX_OK, 1);
+}
+static void bench_mac_init(void) {}
+static void bench_mac_input(void) {}
+static int bench_mac_on(void) { return 1; }
+static int bench_mac_off(int keep_radio_on) { return 1; }
+static unsigned short bench_mac_cci(void) { return 0; }
+
+const struct mac_driver bench_mac_driver = {
+  "bench",
+  bench_mac_init,
+  bench_mac_send,
+  bench_mac_input,
+  bench_mac_on,
+  bench_mac_off,
+  bench_mac_cci
+};
+/*---------------------------------------------------------------------------*/
+struct flow {
+  uip_ipaddr_t srcipaddr, destipaddr;
+  u16_t srcport, destport;
+  uip_lladdr_t *lladdr;
+};
+
+static uip_lladdr_t peer_lladdr = {{0x02, 0, 0, 0, 0, 0, 0, 0x02}};
+static struct flow flows[4];
+/*---------------------------------------------------------------------------*/
+static void
+setup_flows(void)
+{
+  static const uip_lladdr_t my_lladdr = {{0x02, 0, 0, 0, 0, 0, 0, 0x01}};
+
+  memcpy(&uip_lladdr, &my_lladdr, sizeof(uip_lladdr));
+  rimeaddr_set_node_addr((rimeaddr_t *)&my_lladdr);
+
+  /* Addresses derived from the MAC addresses, compressed ports */
+  uip_ip6addr(&flows[0].srcipaddr, 0xfe80, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_set_addr_iid(&flows[0].srcipaddr, &uip_lladdr);
+  uip_ip6addr(&flows[0].destipaddr, 0xfe80, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_set_addr_iid(&flows[0].destipaddr, &peer_lladdr);
+  flows[0].srcport = UIP_HTONS(0xf0b1);
+  flows[0].destport = UIP_HTONS(0xf0b2);
+  flows[0].lladdr = &peer_lladdr;
+
+  /* Link-local, interface identifiers inline */
+  uip_ip6addr(&flows[1].srcipaddr, 0xfe80, 0, 0, 0, 0x1234, 0, 0, 1);
+  uip_ip6addr(&flows[1].destipaddr, 0xfe80, 0, 0, 0, 0x1234, 0, 0, 2);
+  flows[1].srcport = UIP_HTONS(5683);
+  flows[1].destport = UIP_HTONS(5683);
+  flows[1].lladdr = &peer_lladdr;
+
+  /* Global addresses, no context */
+  uip_ip6addr(&flows[2].srcipaddr, 0x2001, 0xdb8, 0, 0, 0, 0, 0, 1);
+  uip_ip6addr(&flows[2].destipaddr, 0x2001, 0xdb8, 0, 0, 0, 0, 0, 2);
+  flows[2].srcport = UIP_HTONS(1234);
+  flows[2].destport = UIP_HTONS(5678);
+  flows[2].lladdr = &peer_lladdr;
+
+  /* Link-local multicast */
+  uip_ip6addr(&flows[3].srcipaddr, 0xfe80, 0, 0, 0, 0, 0, 0, 0);
+  uip_ds6_set_addr_iid(&flows[3].srcipaddr, &uip_lladdr);
+  uip_ip6addr(&flows[3].destipaddr, 0xff02, 0, 0, 0, 0, 0, 0, 1);
+  flows[3].srcport = UIP_HTONS(5684);
+  flows[3].destport = UIP_HTONS(5684);
+  flows[3].lladdr = NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void
+send(struct flow *f)
+{
+  UIP_IP_BUF->vtc = 0x60;
+  UIP_IP_BUF->tcflow = 0;
+  UIP_IP_BUF->flow = 0;
+  UIP_IP_BUF->len[0] = 0;
+  UIP_IP_BUF->len[1] = UIP_UDPH_LEN + PAYLOAD_LEN;
+  UIP_IP_BUF->proto = UIP_PROTO_UDP;
+  UIP_IP_BUF->ttl = 64;
+  uip_ipaddr_copy(&UIP_IP_BUF->srcipaddr, &f->srcipaddr);
+  uip_ipaddr_copy(&UIP_IP_BUF->destipaddr, &f->destipaddr);
+  UIP_UDP_BUF->srcport = f->srcport;
+  UIP_UDP_BUF->destport = f->destport;
+  UIP_UDP_BUF->udplen = UIP_HTONS(UIP_UDPH_LEN + PAYLOAD_LEN);
+  UIP_UDP_BUF->udpchksum = 0;
+  uip_len = UIP_IPUDPH_LEN + PAYLOAD_LEN;
+  tcpip_output(f->lladdr);
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(iphc_bench_process, "IPHC benchmark");
+AUTOSTART_PROCESSES(&iphc_bench_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(iphc_bench_process, ev, data)
+{
+  unsigned long i;
+  clock_time_t start, elapsed;
+
+  PROCESS_BEGIN();
+
+  setup_flows();
+  memset(uip_buf, 0, sizeof(uip_buf));
+
+  printf("IPHC benchmark\n");
+
+  start = clock_time();
+  for(i = 0; i < PACKETS; i++) {
+    send(&flows[i & 3]);
+  }
+  elapsed = clock_time() - start;
+  if(elapsed == 0) {
+    elapsed = 1;
+  }
+
+  printf("%lu packets in %lu ms, %lu packets/s\n",
+         PACKETS, (unsigned long)elapsed,
+         (unsigned long)(PACKETS * CLOCK_SECOND / elapsed));
+  exit(0);
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
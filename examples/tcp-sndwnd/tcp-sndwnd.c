@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2010, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki operating system.
+ *
+ */
+
+/**
+ * \file
+ *         Bulk TCP sender that keeps several segments in flight
+ */
+
+#include "contiki.h"
+#include "contiki-net.h"
+
+#include <stdio.h>
+
+#if !UIP_TCP_SNDWND
+#error "tcp-sndwnd needs UIP_CONF_TCP_SNDWND > 0"
+#endif /* !UIP_TCP_SNDWND */
+
+#define PORT       8080
+#define SEND_BYTES 100000UL
+
+static unsigned long sent;
+/*---------------------------------------------------------------------------*/
+static void
+send_data(void)
+{
+  static char data[UIP_TCP_MSS];
+  u16_t len;
+  u16_t i;
+
+  len = uip_mss();
+  if(len > SEND_BYTES - sent) {
+    len = SEND_BYTES - sent;
+  }
+  if(len > sizeof(data)) {
+    len = sizeof(data);
+  }
+  if(len == 0) {
+    uip_close();
+    return;
+  }
+  /* A byte pattern the receiver can check for holes */
+  for(i = 0; i < len; i++) {
+    data[i] = 'a' + (sent + i) % 26;
+  }
+  uip_send(data, len);
+  sent += len;
+}
+/*---------------------------------------------------------------------------*/
+PROCESS(tcp_sndwnd_process, "TCP send window example");
+AUTOSTART_PROCESSES(&tcp_sndwnd_process);
+/*---------------------------------------------------------------------------*/
+PROCESS_THREAD(tcp_sndwnd_process, ev, data)
+{
+  static clock_time_t start;
+
+  PROCESS_BEGIN();
+
+  tcp_listen(UIP_HTONS(PORT));
+  printf("Sending %lu bytes to each connection on port %d\n",
+         SEND_BYTES, PORT);
+
+  while(1) {
+    PROCESS_WAIT_EVENT_UNTIL(ev == tcpip_event);
+
+    if(uip_connected()) {
+      /* uIP keeps and retransmits the data from now on, the
+         application only ever sends new data */
+      uip_sndwnd_enable();
+      sent = 0;
+      start = clock_time();
+    }
+
+    if(uip_closed() || uip_aborted() || uip_timedout()) {
+      printf("%lu bytes in %lu ms%s\n", sent,
+             (unsigned long)((clock_time() - start) * 1000 / CLOCK_SECOND),
+             uip_closed() ? "" : ", connection lost");
+    } else if(uip_connected() || uip_acked() || uip_poll() ||
+              uip_newdata()) {
+      send_data();
+    }
+  }
+
+  PROCESS_END();
+}
+/*---------------------------------------------------------------------------*/
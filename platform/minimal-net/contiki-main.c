@@ -37,12 +37,12 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <time.h>
-#include <sys/select.h>
 #include <unistd.h>
 #include <memory.h>
 
 #include "contiki.h"
 #include "contiki-net.h"
+#include "native-select.h"
 
 #include "dev/serial-line.h"
 
@@ -101,6 +101,26 @@ interrupt(int sig)
   exit(0);
 }
 /*---------------------------------------------------------------------------*/
+static void
+stdin_handler(int fd)
+{
+  char c;
+  if(read(fd, &c, 1) > 0) {
+    serial_line_input_byte(c);
+  } else {
+    /* End of input: stop watching stdin so that we can idle. */
+    native_select_set_callback(fd, NULL);
+  }
+}
+/*---------------------------------------------------------------------------*/
+#ifndef __CYGWIN__
+static void
+tapdev_handler(int fd)
+{
+  process_poll(&tapdev_process);
+}
+#endif /* !__CYGWIN__ */
+/*---------------------------------------------------------------------------*/
 int
 main(void)
 {
@@ -172,51 +192,15 @@ main(void)
   /* Make standard output unbuffered. */
   setvbuf(stdout, (char *)NULL, _IONBF, 0);
 
-  while(1) {
-    fd_set fds;
-    int n;
-    struct timeval tv;
-    clock_time_t next_event;
-    
-    n = process_run();
-	next_event = etimer_next_expiration_time()-clock_time();
-
-#if DEBUG_SLEEP
-        if(n > 0) {
-      printf("%d events pending\n",n);
-      } else {
-      printf("next event: T-%.03f\n",(double)next_event/(double)CLOCK_SECOND);
-	  }
-#endif
+  native_select_set_callback(STDIN_FILENO, stdin_handler);
+#ifndef __CYGWIN__
+  native_select_set_callback(tapdev_fd(), tapdev_handler);
+#endif /* !__CYGWIN__ */
 
-#ifdef __CYGWIN__
-	/* wpcap doesn't appear to support select, so
-	 * we can't idle the process on windows. */
-	next_event = 0;
-#endif
-
-	if(next_event>CLOCK_SECOND*2)
-		next_event = CLOCK_SECOND*2;
-    tv.tv_sec = n?0:next_event/CLOCK_SECOND;
-    tv.tv_usec = n?0:next_event%1000*1000;
-
-    FD_ZERO(&fds);
-    FD_SET(STDIN_FILENO, &fds);
-#ifdef __CYGWIN__
-    select(1, &fds, NULL, NULL, &tv);
-#else
-    FD_SET(tapdev_fd(), &fds);
-    select(tapdev_fd()+1, &fds, NULL, NULL, &tv);
-#endif
-
-    if(FD_ISSET(STDIN_FILENO, &fds)) {
-      char c;
-      if(read(STDIN_FILENO, &c, 1) > 0) {
-	serial_line_input_byte(c);
-      }
-    }
-	process_poll(&tapdev_process);
-    etimer_request_poll();
+  while(1) {
+    /* wpcap doesn't appear to support select, so on windows the
+     * driver keeps polling itself and the process never idles. */
+    native_select_wait(process_run());
   }
   
   return 0;
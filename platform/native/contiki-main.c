@@ -35,10 +35,10 @@
 
 #include <stdio.h>
 #include <unistd.h>
-#include <sys/select.h>
 
 #include "contiki.h"
 #include "net/netstack.h"
+#include "native-select.h"
 
 #include "dev/serial-line.h"
 
@@ -52,6 +52,18 @@ PROCINIT(&etimer_process, &tcpip_process);
 
 SENSORS(&pir_sensor, &vib_sensor, &button_sensor);
 
+/*---------------------------------------------------------------------------*/
+static void
+stdin_handler(int fd)
+{
+  char c;
+  if(read(fd, &c, 1) > 0) {
+    serial_line_input_byte(c);
+  } else {
+    /* End of input: stop watching stdin so that we can idle. */
+    native_select_set_callback(fd, NULL);
+  }
+}
 /*---------------------------------------------------------------------------*/
 int
 main(void)
@@ -72,41 +84,10 @@ main(void)
   /* Make standard output unbuffered. */
   setvbuf(stdout, (char *)NULL, _IONBF, 0);
   
-  while(1) {
-    fd_set fds;
-    int n;
-    struct timeval tv;
-    
-    clock_time_t next_event;
-	
-    n = process_run();
-    next_event = etimer_next_expiration_time()-clock_time();
+  native_select_set_callback(STDIN_FILENO, stdin_handler);
 
-#if DEBUG_SLEEP
-    if(n > 0) {
-      printf("%d events pending\n",n);
-    } else {
-      printf("next event: T-%.03f\n",(double)next_event/(double)CLOCK_SECOND);
-    }
-#endif
-
-	if(next_event>CLOCK_SECOND*2)
-		next_event = CLOCK_SECOND*2;
-    tv.tv_sec = n?0:next_event/CLOCK_SECOND;
-    tv.tv_usec = n?0:next_event%1000*1000;
-
-    FD_ZERO(&fds);
-    FD_SET(STDIN_FILENO, &fds);
-    select(1, &fds, NULL, NULL, &tv);
-
-    if(FD_ISSET(STDIN_FILENO, &fds)) {
-      char c;
-      if(read(STDIN_FILENO, &c, 1) > 0) {
-	serial_line_input_byte(c);
-      }
-    }
-    
-    etimer_request_poll();
+  while(1) {
+    native_select_wait(process_run());
   }
   
   return 0;